@@ -0,0 +1,321 @@
+#include "../src/file.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * benchmark: every pattern set scans every corpus with every engine, each
+ * run in its own process which generates its corpus, so that its peak RSS is
+ * its own. a baseline row per corpus gives the peak RSS of a process with
+ * the corpus alone. corpora and keywords are generated, the same on every
+ * run.
+ *
+ * usage: bench [megabytes per corpus]
+ */
+
+static unsigned long g_seed = 1;
+
+/* deterministic pseudo-random numbers */
+static unsigned long next_random() {
+  g_seed = g_seed * 6364136223846793005UL + 1442695040888963407UL;
+  return g_seed >> 33;
+}
+
+static char *pick(char **words, size_t len) {
+  return words[next_random() % len];
+}
+
+/*
+ * corpora
+ */
+
+typedef struct Corpus {
+  char *name;
+  void (*line)(char *); /* write a random line of the corpus */
+  char *text;           /* NULL until generated */
+  IdxType len;
+} Corpus;
+
+static char *g_identifiers[] = {"count", "buffer", "len", "i", "node",
+                                "next", "value", "result", "ptr", "size"};
+#define IDENTIFIERS_LEN (sizeof(g_identifiers) / sizeof(char *))
+
+static void c_source_line(char *line) {
+  switch (next_random() % 5) {
+  case 0:
+    sprintf(line, "  for (int %s = 0; %s < %lu; ++%s) {\n",
+            pick(g_identifiers, IDENTIFIERS_LEN), "i", next_random() % 1000,
+            "i");
+    break;
+  case 1:
+    sprintf(line, "    %s = %s->%s + %lu;\n",
+            pick(g_identifiers, IDENTIFIERS_LEN),
+            pick(g_identifiers, IDENTIFIERS_LEN),
+            pick(g_identifiers, IDENTIFIERS_LEN), next_random() % 100);
+    break;
+  case 2:
+    sprintf(line, "  if (%s != NULL && %s >= 0.5) return \"%s\";\n",
+            pick(g_identifiers, IDENTIFIERS_LEN),
+            pick(g_identifiers, IDENTIFIERS_LEN),
+            pick(g_identifiers, IDENTIFIERS_LEN));
+    break;
+  case 3:
+    sprintf(line, "  // update the %s of the %s\n",
+            pick(g_identifiers, IDENTIFIERS_LEN),
+            pick(g_identifiers, IDENTIFIERS_LEN));
+    break;
+  default:
+    sprintf(line, "static unsigned long %s(char *%s, int %s) {\n",
+            pick(g_identifiers, IDENTIFIERS_LEN),
+            pick(g_identifiers, IDENTIFIERS_LEN),
+            pick(g_identifiers, IDENTIFIERS_LEN));
+  }
+}
+
+static void log_line(char *line) {
+  static char *levels[] = {"INFO", "WARN", "ERROR", "DEBUG"};
+  static char *paths[] = {"/api/v1/users", "/api/v1/orders", "/health",
+                          "/static/app.js"};
+  sprintf(line,
+          "2024-03-%02lu %02lu:%02lu:%02lu %s [worker-%lu] request "
+          "id=%lu path=%s status=%lu latency=%lums\n",
+          next_random() % 28 + 1, next_random() % 24, next_random() % 60,
+          next_random() % 60, pick(levels, 4), next_random() % 16,
+          next_random() % 1000000, pick(paths, 4),
+          next_random() % 2 ? 200UL : 404UL, next_random() % 500);
+}
+
+static void json_line(char *line) {
+  sprintf(line,
+          "{\"id\": %lu, \"name\": \"%s\", \"tags\": [\"%s\", \"%s\"], "
+          "\"score\": %lu.%lu, \"active\": %s},\n",
+          next_random() % 100000, pick(g_identifiers, IDENTIFIERS_LEN),
+          pick(g_identifiers, IDENTIFIERS_LEN),
+          pick(g_identifiers, IDENTIFIERS_LEN), next_random() % 100,
+          next_random() % 100, next_random() % 2 ? "true" : "false");
+}
+
+/* generate the text of a corpus, from its own seed */
+static void make_corpus(Corpus *corpus, IdxType len, unsigned long seed) {
+  g_seed = seed;
+  corpus->text = (char *)malloc(len + 256);
+  corpus->len = 0;
+  char buffer[256];
+  while (corpus->len < len) {
+    corpus->line(buffer);
+    IdxType n = strlen(buffer);
+    memcpy(corpus->text + corpus->len, buffer, n);
+    corpus->len += n;
+  }
+  corpus->text[corpus->len] = '\0';
+}
+
+/*
+ * pattern sets
+ */
+
+typedef struct PatternSet {
+  char *name;
+  char **patterns;
+  size_t len;
+  bool trie; /* if `compile` may give literal patterns to a trie */
+} PatternSet;
+
+static char *g_single[] = {"[0-9]+\\.[0-9]+|[0-9]+"};
+
+static char *g_lexer[] = {
+    /* 32 keywords */
+    "auto", "break", "case", "char", "const", "continue", "default", "do",
+    "double", "else", "enum", "extern", "float", "for", "goto", "if", "int",
+    "long", "register", "return", "short", "signed", "sizeof", "static",
+    "struct", "switch", "typedef", "union", "unsigned", "void", "volatile",
+    "while",
+    /* 11 operators and punctuation */
+    "\\+\\+", "\\-\\-", "\\->", "&&", "\\|\\|", "<=", ">=", "==", "!=",
+    "[\\+\\-\\*/%<>=!&\\|\\^~]", "[\\(\\)\\[\\]{};,\\.:]",
+    /* 7 others */
+    "[a-zA-Z_][a-zA-Z0-9_]*", "[0-9]+", "[0-9]+\\.[0-9]+", "\"[^\"\\n]*\"",
+    "'[^'\\n]*'", "[ \\t\\n]+", "//[^\\n]*"};
+
+#define KEYWORDS_LEN 5000
+
+/* generated keywords, then rules taking everything else, all allocated */
+static PatternSet make_keywords() {
+  /* a few words of the corpora are keywords too */
+  static char *words[] = {"count", "request"};
+  static char *others[] = {"[a-zA-Z_][a-zA-Z0-9_]*", "[0-9]+", "[ \\t\\n]+",
+                           "."};
+  size_t len = KEYWORDS_LEN + 4;
+  char **patterns = (char **)malloc(len * sizeof(char *));
+  for (size_t i = 0; i < 2; ++i)
+    patterns[i] = strdup(words[i]);
+  for (size_t i = 2; i < KEYWORDS_LEN; ++i) {
+    size_t n = 4 + next_random() % 7;
+    patterns[i] = (char *)malloc(n + 1);
+    for (size_t j = 0; j < n; ++j)
+      patterns[i][j] = 'a' + next_random() % 26;
+    patterns[i][n] = '\0';
+  }
+  for (size_t i = 0; i < 4; ++i)
+    patterns[KEYWORDS_LEN + i] = strdup(others[i]);
+  return (PatternSet){"keywords5k", patterns, len, true};
+}
+
+static void free_keywords(PatternSet *keywords) {
+  for (size_t i = 0; i < keywords->len; ++i)
+    free(keywords->patterns[i]);
+  free(keywords->patterns);
+}
+
+/*
+ * runs
+ */
+
+typedef struct Result {
+  double build_ms;
+  double scan_s;
+  unsigned long tokens;
+  IdxType scanned; /* bytes scanned, less than the corpus if too slow */
+} Result;
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the same as `compile`, with all patterns in the engine and no trie */
+static Automaton *compile_without_trie(char **patterns, size_t len,
+                                       Engine engine) {
+  Automaton *automaton = (Automaton *)malloc(sizeof(Automaton));
+  automaton->engine = engine;
+  automaton->trie = NULL;
+  automaton->nfa = build_many(patterns, len);
+  automaton->dfa = NULL;
+  if (engine == ENGINE_DFA) {
+    automaton->dfa = nfa2dfa(automaton->nfa);
+    dfa_minimize(automaton->dfa);
+  }
+  automaton->nfa_patterns = (int *)malloc((len + 1) * sizeof(int));
+  for (size_t i = 0; i < len; ++i)
+    automaton->nfa_patterns[i] = i;
+  automaton->nfa_patterns_len = len;
+  /* the scanner makes its lazy DFA with `new_lazy_dfa` */
+  automaton->lazy_budget = LAZY_DEFAULT_BUDGET;
+  return automaton;
+}
+
+#define RUN_MAX_SECONDS 5
+
+static Result run(PatternSet *set, Corpus *corpus, Engine engine) {
+  Result result = {0, 0, 0, 0};
+  double start = now();
+  Automaton *automaton =
+      set->trie ? compile(set->patterns, set->len, engine)
+                : compile_without_trie(set->patterns, set->len, engine);
+  Scanner *scanner = new_scanner(automaton);
+  result.build_ms = (now() - start) * 1000;
+
+  start = now();
+  scanner_set_buffer(scanner, corpus->text, corpus->len);
+  while (!scanner_is_done(scanner)) {
+    if (scanner_match_span(scanner).pattern < 0)
+      break;
+    /* an engine too slow for the corpus is measured on its beginning */
+    if (++result.tokens % 1024 == 0 && now() - start > RUN_MAX_SECONDS)
+      break;
+  }
+  result.scan_s = now() - start;
+  result.scanned = scanner->buffer_ptr - scanner->buffer;
+
+  free_scanner(scanner);
+  free_automaton(automaton);
+  return result;
+}
+
+static char *g_engine_names[] = {"nfa", "dfa", "lazy-dfa"};
+
+/*
+ * generate the corpus and run in a child process, and print the result with
+ * its peak RSS. without a pattern set, only the corpus is generated.
+ */
+static void report(PatternSet *set, Corpus *corpus, IdxType len,
+                   unsigned long seed, Engine engine) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    perror("pipe");
+    exit(1);
+  }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    make_corpus(corpus, len, seed);
+    Result result = {0, 0, 0, 0};
+    if (set != NULL)
+      result = run(set, corpus, engine);
+    if (write(fds[1], &result, sizeof(result)) != sizeof(result))
+      _exit(1);
+    _exit(0);
+  }
+  close(fds[1]);
+  Result result;
+  bool ok = read(fds[0], &result, sizeof(result)) == sizeof(result);
+  close(fds[0]);
+  int status;
+  struct rusage usage;
+  wait4(pid, &status, 0, &usage);
+  char *set_name = set != NULL ? set->name : "baseline";
+  char *engine_name = set != NULL ? g_engine_names[engine] : "-";
+  if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    printf("%-18s %-7s %-9s failed\n", set_name, corpus->name, engine_name);
+    return;
+  }
+
+  if (set == NULL) {
+    printf("%-18s %-7s %-9s %10s %10s %12s %10ld\n", set_name, corpus->name,
+           engine_name, "-", "-", "-", usage.ru_maxrss);
+    return;
+  }
+  double mb = result.scanned / 1e6;
+  printf("%-18s %-7s %-9s %10.2f %10.2f %12.0f %10ld\n", set_name,
+         corpus->name, engine_name, result.build_ms, mb / result.scan_s,
+         result.tokens / result.scan_s, usage.ru_maxrss);
+}
+
+int main(int argc, char *argv[]) {
+  double megabytes = argc > 1 ? atof(argv[1]) : 4;
+  IdxType len = megabytes * 1e6;
+
+  /* generated by each run, so that no run holds the other corpora */
+  Corpus corpora[] = {
+      {"c", c_source_line, NULL, 0},
+      {"log", log_line, NULL, 0},
+      {"json", json_line, NULL, 0},
+  };
+  PatternSet keywords = make_keywords();
+  PatternSet sets[] = {
+      {"single", g_single, sizeof(g_single) / sizeof(char *), true},
+      {"lexer50", g_lexer, sizeof(g_lexer) / sizeof(char *), true},
+      keywords,
+      /* the keywords through the NFA too, which the trie otherwise takes */
+      {"keywords5k-no-trie", keywords.patterns, keywords.len, false},
+  };
+  Engine engines[] = {ENGINE_NFA, ENGINE_DFA, ENGINE_LAZY_DFA};
+
+  printf("%-18s %-7s %-9s %10s %10s %12s %10s\n", "patterns", "corpus",
+         "engine", "build ms", "MB/s", "tokens/s", "RSS KB");
+  for (size_t c = 0; c < sizeof(corpora) / sizeof(Corpus); ++c)
+    report(NULL, &corpora[c], len, c + 1, ENGINE_NFA);
+  for (size_t s = 0; s < sizeof(sets) / sizeof(PatternSet); ++s)
+    for (size_t c = 0; c < sizeof(corpora) / sizeof(Corpus); ++c)
+      for (size_t e = 0; e < sizeof(engines) / sizeof(Engine); ++e)
+        report(&sets[s], &corpora[c], len, c + 1, engines[e]);
+
+  free_keywords(&keywords);
+  return 0;
+}
@@ -8,10 +8,18 @@ cat >$target_file <<EOF
  * For embedding into lers projects
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 EOF
 
 cat >>$target_file <<EOF
@@ -27,6 +35,17 @@ cat src/state.c >>$target_file
 
 cat >>$target_file <<EOF
 
+/*
+ * ============================================================================
+ * util/arena.c - Bump allocator freed all at once
+ * ============================================================================
+ */
+EOF
+
+cat src/util/arena.c >>$target_file
+
+cat >>$target_file <<EOF
+
 /*
  * ============================================================================
  * builder/lexer.c - Lexer for regular expressions
@@ -60,6 +79,17 @@ cat src/builder/parser.c >>$target_file
 
 cat >>$target_file <<EOF
 
+/*
+ * ============================================================================
+ * util/charset.c - Set of chars as a bitmap
+ * ============================================================================
+ */
+EOF
+
+cat src/util/charset.c >>$target_file
+
+cat >>$target_file <<EOF
+
 /*
  * ============================================================================
  * edge.c - Edges between states
@@ -82,6 +112,17 @@ cat src/nfa.c >>$target_file
 
 cat >>$target_file <<EOF
 
+/*
+ * ============================================================================
+ * bitnfa.c - Bit-parallel matcher for small patterns
+ * ============================================================================
+ */
+EOF
+
+cat src/bitnfa.c >>$target_file
+
+cat >>$target_file <<EOF
+
 /*
  * ============================================================================
  * builder.c - Build an NFA from a string
@@ -93,6 +134,61 @@ cat src/builder.c >>$target_file
 
 cat >>$target_file <<EOF
 
+/*
+ * ============================================================================
+ * dfa.c - DFA (Deterministic Finite Automaton) built by subset construction
+ * ============================================================================
+ */
+EOF
+
+cat src/dfa.c >>$target_file
+
+cat >>$target_file <<EOF
+
+/*
+ * ============================================================================
+ * serialize.c - Save DFAs to files, and map them back
+ * ============================================================================
+ */
+EOF
+
+cat src/serialize.c >>$target_file
+
+cat >>$target_file <<EOF
+
+/*
+ * ============================================================================
+ * codegen.c - Write a DFA as the C source of a scanner
+ * ============================================================================
+ */
+EOF
+
+cat src/codegen.c >>$target_file
+
+cat >>$target_file <<EOF
+
+/*
+ * ============================================================================
+ * jit.c - Compile a DFA to x86-64 code
+ * ============================================================================
+ */
+EOF
+
+cat src/jit.c >>$target_file
+
+cat >>$target_file <<EOF
+
+/*
+ * ============================================================================
+ * lazy.c - DFA built on demand while matching, with a memory budget
+ * ============================================================================
+ */
+EOF
+
+cat src/lazy.c >>$target_file
+
+cat >>$target_file <<EOF
+
 /*
  * ============================================================================
  * match.c - Functions to match string with patterns
@@ -102,8 +198,52 @@ EOF
 
 cat src/match.c >>$target_file
 
+cat >>$target_file <<EOF
+
+/*
+ * ============================================================================
+ * literal.c - Trie for patterns matching fixed strings
+ * ============================================================================
+ */
+EOF
+
+cat src/literal.c >>$target_file
+
+cat >>$target_file <<EOF
+
+/*
+ * ============================================================================
+ * scanner.c - Reentrant scanners over a shared compiled automaton
+ * ============================================================================
+ */
+EOF
+
+cat src/scanner.c >>$target_file
+
+cat >>$target_file <<EOF
+
+/*
+ * ============================================================================
+ * parallel.c - Scan a large buffer on several threads
+ * ============================================================================
+ */
+EOF
+
+cat src/parallel.c >>$target_file
+
+cat >>$target_file <<EOF
+
+/*
+ * ============================================================================
+ * file.c - Scan a memory-mapped file
+ * ============================================================================
+ */
+EOF
+
+cat src/file.c >>$target_file
+
 # remove `#include`s from source codes
-sed -i '10,${/#include/d}' $target_file
+sed -i '18,${/#include/d}' $target_file
 
 # fix `#include "util/vector.c"`
 sed -i '/#define TYPE/{
@@ -0,0 +1,168 @@
+#include "builder/parser.c"
+#include "nfa.c"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * bit-parallel matcher for small patterns: the chars and sets of the patterns
+ * are numbered as positions (Glushkov), and while matching, the positions
+ * the input can be at fit in one 64-bit word. a step ORs the positions that
+ * may follow the current ones, from one table per byte of the word, and ANDs
+ * the positions of the input char. nothing is allocated while matching.
+ */
+
+#define BITNFA_MAX_POSITIONS 64
+
+typedef struct BitNFA {
+  unsigned int positions_count;
+  unsigned int follow_bytes; /* bytes of the word used by positions */
+  uint64_t first;            /* positions the first char can be at */
+  uint64_t chars[256];       /* positions each char can be at */
+  uint64_t follow[8][256];   /* positions following the ones in a byte */
+  uint64_t accepting;        /* positions ending some pattern */
+  unsigned int patterns_count;
+  uint64_t last[BITNFA_MAX_POSITIONS]; /* positions ending each pattern */
+  bool nullable;                       /* if some pattern matches "" */
+} BitNFA;
+
+/* first, last positions and nullable of a sub-expression */
+typedef struct BitPositions {
+  uint64_t first;
+  uint64_t last;
+  bool nullable;
+} BitPositions;
+
+/* make each position of `last` followed by the positions of `first` */
+static void follow_positions(BitNFA *bits, uint64_t *follow, uint64_t last,
+                             uint64_t first) {
+  for (unsigned int i = 0; i < bits->positions_count; ++i)
+    if (last & ((uint64_t)1 << i))
+      follow[i] |= first;
+}
+
+/* the positions of a sub-expression followed by another */
+static BitPositions concat_bit_positions(BitNFA *bits, uint64_t *follow,
+                                         BitPositions r1, BitPositions r2) {
+  follow_positions(bits, follow, r1.last, r2.first);
+  return (BitPositions){r1.nullable ? r1.first | r2.first : r1.first,
+                        r2.nullable ? r1.last | r2.last : r2.last,
+                        r1.nullable && r2.nullable};
+}
+
+/* number the positions of an AST, and fill `chars` and `follow` */
+static BitPositions bit_positions(BitNFA *bits, uint64_t *follow, Ast *ast) {
+  BitPositions g, r1, r2;
+  switch (ast->type) {
+  case LiteralNode: {
+    uint64_t bit = (uint64_t)1 << bits->positions_count++;
+    bits->chars[(unsigned char)ast->data.AstLiteral.value] |= bit;
+    return (BitPositions){bit, bit, false};
+  }
+  case SetNode: {
+    uint64_t bit = (uint64_t)1 << bits->positions_count++;
+    for (int c = 0; c < 256; ++c)
+      if (have_char(ast->data.AstSet.set, (char)c))
+        bits->chars[c] |= bit;
+    return (BitPositions){bit, bit, false};
+  }
+  case AndNode:
+    r1 = bit_positions(bits, follow, ast->data.AstAnd.r1);
+    r2 = bit_positions(bits, follow, ast->data.AstAnd.r2);
+    return concat_bit_positions(bits, follow, r1, r2);
+  case OrNode:
+    r1 = bit_positions(bits, follow, ast->data.AstOr.r1);
+    r2 = bit_positions(bits, follow, ast->data.AstOr.r2);
+    return (BitPositions){r1.first | r2.first, r1.last | r2.last,
+                      r1.nullable || r2.nullable};
+  case RepeatNode:
+    g = bit_positions(bits, follow, ast->data.AstRepeat.r);
+    follow_positions(bits, follow, g.last, g.first);
+    g.nullable = true;
+    return g;
+  case SurroundNode:
+    return bit_positions(bits, follow, ast->data.AstSurround.r);
+  case CountNode: {
+    /* copies one after another, see `count_fragment` */
+    int max = ast->data.AstCount.max;
+    unsigned int min = ast->data.AstCount.min;
+    unsigned int copies = max < 0 ? (min > 0 ? min : 1) : (unsigned int)max;
+    g = (BitPositions){0, 0, true};
+    for (unsigned int i = 0; i < copies; ++i) {
+      r1 = bit_positions(bits, follow, ast->data.AstCount.r);
+      if (max < 0 && i + 1 == copies)
+        follow_positions(bits, follow, r1.last, r1.first);
+      if (i >= min)
+        r1.nullable = true;
+      g = concat_bit_positions(bits, follow, g, r1);
+    }
+    return g;
+  }
+  }
+  exit(EXIT_FAILURE);
+}
+
+/*
+ * create a bit-parallel matcher for patterns, the first pattern has the
+ * highest priority. return NULL if they have too many positions.
+ */
+BitNFA *new_bitnfa(Ast **asts, size_t len) {
+  unsigned int positions_count = 0;
+  for (size_t i = 0; i < len; ++i)
+    positions_count += count_positions(asts[i], BITNFA_MAX_POSITIONS);
+  if (positions_count > BITNFA_MAX_POSITIONS || len > BITNFA_MAX_POSITIONS)
+    return NULL;
+
+  BitNFA *bits = (BitNFA *)calloc(1, sizeof(BitNFA));
+  uint64_t follow[BITNFA_MAX_POSITIONS] = {0};
+  bits->patterns_count = len;
+  for (size_t i = 0; i < len; ++i) {
+    BitPositions g = bit_positions(bits, follow, asts[i]);
+    bits->first |= g.first;
+    bits->last[i] = g.last;
+    bits->accepting |= g.last;
+    bits->nullable = bits->nullable || g.nullable;
+  }
+
+  bits->follow_bytes = (bits->positions_count + 7) / 8;
+  for (unsigned int k = 0; k < bits->follow_bytes; ++k)
+    for (unsigned int byte = 0; byte < 256; ++byte)
+      for (unsigned int j = 0; j < 8; ++j)
+        if (byte & (1 << j) && 8 * k + j < bits->positions_count)
+          bits->follow[k][byte] |= follow[8 * k + j];
+  return bits;
+}
+
+/* the positions after reading `c` at positions `d` */
+static inline uint64_t bitnfa_step(BitNFA *bits, uint64_t d, char c) {
+  uint64_t reach = 0;
+  for (unsigned int k = 0; k < bits->follow_bytes; ++k)
+    reach |= bits->follow[k][(d >> (8 * k)) & 0xff];
+  return reach & bits->chars[(unsigned char)c];
+}
+
+/* the positions after reading `c` first */
+static inline uint64_t bitnfa_start(BitNFA *bits, char c) {
+  return bits->first & bits->chars[(unsigned char)c];
+}
+
+/* the index of the first pattern ending at positions `d`, or -1 */
+static inline int bitnfa_accepted(BitNFA *bits, uint64_t d) {
+  if ((d & bits->accepting) == 0)
+    return -1;
+  for (unsigned int i = 0; i < bits->patterns_count; ++i)
+    if (d & bits->last[i])
+      return i;
+  return -1;
+}
+
+/* if the input string fully matches some pattern */
+bool bitnfa_match_full(BitNFA *bits, char *input) {
+  if (*input == '\0')
+    return bits->nullable;
+  uint64_t d = bitnfa_start(bits, *input);
+  for (char *next_char = input + 1; *next_char != '\0' && d != 0; ++next_char)
+    d = bitnfa_step(bits, d, *next_char);
+  return bitnfa_accepted(bits, d) >= 0;
+}
@@ -1,92 +1,139 @@
-#include "builder/parser.c"
-#include "nfa.c"
+#include "bitnfa.c"
 #include <stddef.h>
 #include <stdlib.h>
 
-static State g_state_counts = 0;
+/* how patterns are turned into NFAs */
+typedef enum Construction {
+  THOMPSON, /* a few states and ε-edges around each operator */
+  GLUSHKOV, /* one state per char or set of the pattern, no ε-edge */
+} Construction;
 
+/* the construction of `build` and `build_many` */
+#ifndef DEFAULT_CONSTRUCTION
+#define DEFAULT_CONSTRUCTION THOMPSON
+#endif
+
+/* state of one build, so that builds share nothing */
+typedef struct Builder {
+  State state_counts;
+  NFA *nfa; /* the NFA all edges go to */
+} Builder;
+
+/* the start and accept states of the part of the NFA built for an AST */
 typedef struct {
-  NFA *nfa;
   State start;
   State accept;
 } NFAFragment;
 
-/* create a new NFA fragment */
-static NFAFragment *new_nfa_fragment(NFA *nfa, State start, State accept) {
-  NFAFragment *fragment = (NFAFragment *)malloc(sizeof(NFAFragment));
-  fragment->nfa = nfa;
-  fragment->start = start;
-  fragment->accept = accept;
-  return fragment;
-}
-
-/* get current state counts */
-static State get_state_counts() { return g_state_counts; }
-
 /* increase states counts and get the latest state number */
-static State increase_state_counts() { return g_state_counts++; }
+static State increase_state_counts(Builder *b) { return b->state_counts++; }
 
 /* decrease states counts by one, used to concatenate two NFA */
-static void decrease_state_counts() { --g_state_counts; }
+static void decrease_state_counts(Builder *b) { --b->state_counts; }
 
 /* add an ε-labled edge to the NFA */
 static void add_epsilon(NFA *nfa, State from, State to) {
-  push_edge(nfa, new_edge(new_literal_label(EPSILON), from, to));
+  push_edge(nfa, new_edge(nfa->arena, new_literal_label(nfa->arena, EPSILON),
+                          from, to));
 }
 
 /* add a symbol-labled edge to the NFA */
 static void add_symbol(NFA *nfa, State from, State to, char symbol) {
-  push_edge(nfa, new_edge(new_literal_label(symbol), from, to));
+  push_edge(nfa, new_edge(nfa->arena, new_literal_label(nfa->arena, symbol),
+                          from, to));
 }
 
-static void add_set(NFA *nfa, State from, State to, Vector_char *set,
-                    bool is_neg) {
-  push_edge(nfa, new_edge(new_set_label(set, is_neg), from, to));
+/* add a set-labled edge to the NFA */
+static void add_set(NFA *nfa, State from, State to, CharSet *set) {
+  push_edge(nfa,
+            new_edge(nfa->arena, new_set_label(nfa->arena, set), from, to));
 }
 
-/* move all edges from source NFA to destination NFA */
-static void move_edges(NFA *dst, NFA *src) {
-  for (size_t i = 0; i < src->edges_count; ++i) {
-    push_edge(dst, src->edges[i]);
-  }
-  src->edges_count = 0;
+static NFAFragment ast2nfa_fragment(Builder *b, Ast *ast);
+
+/*
+ * r* if `skip`, else r+
+ *
+ *               .-<-ε-<-.
+ *              /         \
+ * START --ε--> S₀ --r--> S₁ --ε--> END
+ *     \                            /
+ *      .------->-ε-> if skip ------.
+ */
+static NFAFragment loop_fragment(Builder *b, Ast *r, bool skip) {
+  State start = increase_state_counts(b);
+  NFAFragment body = ast2nfa_fragment(b, r);
+  State accept = increase_state_counts(b);
+  add_epsilon(b->nfa, start, body.start);
+  if (skip)
+    add_epsilon(b->nfa, start, accept);
+  add_epsilon(b->nfa, body.accept, body.start);
+  add_epsilon(b->nfa, body.accept, accept);
+  return (NFAFragment){start, accept};
 }
 
-static NFAFragment *ast2nfa_fragment(Ast *ast) {
-  if (ast == NULL)
-    return NULL;
+/*
+ * r{min,max}: copies of r one after another, and an ε-edge over each copy
+ * after the first `min`. without upper bound, the last copy is r+, or r* for
+ * r{0,}. the copies are built from the same AST.
+ *
+ * r{1,3}: START --r--> S₁ --r--> S₂ --r--> END
+ *                       \-ε->-/  \-ε->-/
+ */
+static NFAFragment count_fragment(Builder *b, Ast *r, unsigned int min,
+                                  int max) {
+  unsigned int copies = max < 0 ? (min > 0 ? min : 1) : (unsigned int)max;
+  if (copies == 0) {
+    State start = increase_state_counts(b);
+    State accept = increase_state_counts(b);
+    add_epsilon(b->nfa, start, accept);
+    return (NFAFragment){start, accept};
+  }
 
+  NFAFragment result = {0, 0};
+  for (unsigned int i = 0; i < copies; ++i) {
+    if (i > 0)
+      decrease_state_counts(b); /* concatenate the copies */
+    NFAFragment copy;
+    if (max < 0 && i + 1 == copies) {
+      copy = loop_fragment(b, r, min == 0);
+    } else {
+      copy = ast2nfa_fragment(b, r);
+      if (i >= min)
+        add_epsilon(b->nfa, copy.start, copy.accept);
+    }
+    if (i == 0)
+      result.start = copy.start;
+    result.accept = copy.accept;
+  }
+  return result;
+}
+
+static NFAFragment ast2nfa_fragment(Builder *b, Ast *ast) {
+  NFA *nfa = b->nfa;
   switch (ast->type) {
   case LiteralNode: {
     /* START --literal--> END */
-    NFA *nfa = new_nfa();
-    State start = increase_state_counts();
-    State accept = increase_state_counts();
+    State start = increase_state_counts(b);
+    State accept = increase_state_counts(b);
     add_symbol(nfa, start, accept, ast->data.AstLiteral.value);
-    return new_nfa_fragment(nfa, start, accept);
+    return (NFAFragment){start, accept};
   }
 
   case SetNode: {
     /* START --set--> END */
-    NFA *nfa = new_nfa();
-    State start = increase_state_counts();
-    State accept = increase_state_counts();
-    add_set(nfa, start, accept, ast->data.AstSet.set, ast->data.AstSet.is_neg);
-    return new_nfa_fragment(nfa, start, accept);
+    State start = increase_state_counts(b);
+    State accept = increase_state_counts(b);
+    add_set(nfa, start, accept, ast->data.AstSet.set);
+    return (NFAFragment){start, accept};
   }
 
   case AndNode: {
     /* START --left--> (left end & right start) --right--> END */
-    NFAFragment *left = ast2nfa_fragment(ast->data.AstAnd.r1);
-    decrease_state_counts(); /* concatenate left end and right start */
-    NFAFragment *right = ast2nfa_fragment(ast->data.AstAnd.r2);
-    move_edges(left->nfa, right->nfa);
-    free(right->nfa);
-    NFAFragment *result =
-        new_nfa_fragment(left->nfa, left->start, right->accept);
-    free(left);
-    free(right);
-    return result;
+    NFAFragment left = ast2nfa_fragment(b, ast->data.AstAnd.r1);
+    decrease_state_counts(b); /* concatenate left end and right start */
+    NFAFragment right = ast2nfa_fragment(b, ast->data.AstAnd.r2);
+    return (NFAFragment){left.start, right.accept};
   }
 
   case OrNode: {
@@ -95,23 +142,15 @@ static NFAFragment *ast2nfa_fragment(Ast *ast) {
      * START --<                            >--> END
      *          \-ε--> S₂ --right--> S₃ -ε-/
      */
-    NFA *nfa = new_nfa();
-    State start = increase_state_counts();
-    NFAFragment *left = ast2nfa_fragment(ast->data.AstOr.r1);
-    NFAFragment *right = ast2nfa_fragment(ast->data.AstOr.r2);
-    State accept = increase_state_counts();
-    add_epsilon(nfa, start, left->start);
-    add_epsilon(nfa, start, right->start);
-    add_epsilon(nfa, left->accept, accept);
-    add_epsilon(nfa, right->accept, accept);
-    move_edges(nfa, left->nfa);
-    move_edges(nfa, right->nfa);
-    free(left->nfa);
-    free(right->nfa);
-    NFAFragment *result = new_nfa_fragment(nfa, start, accept);
-    free(left);
-    free(right);
-    return result;
+    State start = increase_state_counts(b);
+    NFAFragment left = ast2nfa_fragment(b, ast->data.AstOr.r1);
+    NFAFragment right = ast2nfa_fragment(b, ast->data.AstOr.r2);
+    State accept = increase_state_counts(b);
+    add_epsilon(nfa, start, left.start);
+    add_epsilon(nfa, start, right.start);
+    add_epsilon(nfa, left.accept, accept);
+    add_epsilon(nfa, right.accept, accept);
+    return (NFAFragment){start, accept};
   }
 
   case RepeatNode: {
@@ -122,72 +161,266 @@ static NFAFragment *ast2nfa_fragment(Ast *ast) {
      *     \                            /
      *      .---------->-ε->-----------.
      */
-    NFA *nfa = new_nfa();
-    State start = increase_state_counts();
-    NFAFragment *body = ast2nfa_fragment(ast->data.AstRepeat.r);
-    State accept = increase_state_counts();
-    move_edges(nfa, body->nfa);
-    add_epsilon(nfa, start, body->start);
-    add_epsilon(nfa, start, accept);
-    add_epsilon(nfa, body->accept, body->start);
-    add_epsilon(nfa, body->accept, accept);
-    free(body->nfa);
-    NFAFragment *result = new_nfa_fragment(nfa, start, accept);
-    free(body);
-    return result;
+    return loop_fragment(b, ast->data.AstRepeat.r, true);
   }
 
   case SurroundNode: {
     /* START --r--> END */
-    return ast2nfa_fragment(ast->data.AstSurround.r);
+    return ast2nfa_fragment(b, ast->data.AstSurround.r);
   }
 
+  case CountNode:
+    return count_fragment(b, ast->data.AstCount.r, ast->data.AstCount.min,
+                          ast->data.AstCount.max);
+
   default:
     exit(1);
   }
 }
 
-NFA *ast2nfa(Ast *ast) {
-  NFAFragment *fragment = ast2nfa_fragment(ast);
-  NFA *nfa = fragment->nfa;
-  free(fragment);
-  free_ast(ast);
+/* parse a pattern to an AST allocated from the arena */
+Ast *parse_pattern(Arena *arena, char *pattern) {
+  Lexer *lexer = new_lexer(pattern);
+  Parser *parser = new_parser(lexer, arena);
+  Ast *ast = parse(parser);
+  free(lexer);
+  free(parser);
+  return ast;
+}
+
+/*
+ * parse patterns to simplified ASTs allocated from the NFA's arena, see
+ * `simplify_asts`
+ */
+static Ast **parse_patterns(NFA *nfa, char **patterns, size_t len) {
+  Ast **asts = (Ast **)malloc((len + 1) * sizeof(Ast *));
+  Arena *parsed = new_arena();
+  for (size_t i = 0; i < len; ++i)
+    asts[i] = parse_pattern(parsed, patterns[i]);
+  simplify_asts(nfa->arena, asts, len, &nfa->ast_stats);
+  free_arena(parsed);
+  return asts;
+}
 
-  nfa->states_count = g_state_counts;
+/*
+ * Glushkov construction: each char or set of a pattern is a state, entered
+ * by the edges labeled with it. an edge goes from each state that can end a
+ * sub-pattern to each state that can start what follows it, and from the
+ * start state to the states that can start the pattern.
+ */
 
-  States *target_states = new_states();
-  push_state(target_states, g_state_counts - 1);
-  nfa->target_states = target_states;
-  return nfa;
+typedef struct Positions {
+  States *first; /* states that can start the sub-pattern */
+  States *last;  /* states that can end it */
+  bool nullable; /* if it matches "" */
+} Positions;
+
+typedef struct Glushkov {
+  Builder *b;
+  NFA *nfa;
+  Label **labels; /* the label of the edges entering each state */
+  size_t labels_capacity;
+} Glushkov;
+
+/* the label of the edges entering the state of a char or set */
+static Label *position_label(Arena *arena, Ast *leaf) {
+  switch (leaf->type) {
+  case LiteralNode:
+    return new_literal_label(arena, leaf->data.AstLiteral.value);
+  case SetNode:
+    return new_set_label(arena, leaf->data.AstSet.set);
+  default:
+    exit(1);
+  }
 }
 
-NFA *build(char *pattern) {
-  Lexer *lexer = new_lexer(pattern);
-  Parser *parser = new_parser(lexer);
-  Ast *ast = parse(parser);
-  NFA *nfa = ast2nfa(ast);
-  if (lexer->current_token != NULL) {
-    free(lexer->current_token);
+/* add edges from all states in `from` to all states in `to` */
+static void connect_positions(Glushkov *g, States *from, States *to) {
+  for (size_t i = 0; i < from->len; ++i)
+    for (size_t j = 0; j < to->len; ++j)
+      push_edge(g->nfa, new_edge(g->nfa->arena, g->labels[to->states[j]],
+                                 from->states[i], to->states[j]));
+}
+
+/* push all states of `src` into `dst` */
+static void push_all_states(States *dst, States *src) {
+  for (size_t i = 0; i < src->len; ++i)
+    push_state(dst, src->states[i]);
+}
+
+/* the positions of a sub-pattern followed by another */
+static Positions concat_positions(Glushkov *g, Positions left,
+                                  Positions right) {
+  connect_positions(g, left.last, right.first);
+  if (left.nullable)
+    push_all_states(left.first, right.first);
+  if (right.nullable)
+    push_all_states(right.last, left.last);
+  Positions p = {left.first, right.last, left.nullable && right.nullable};
+  free_states(left.last);
+  free_states(right.first);
+  return p;
+}
+
+static Positions glushkov_positions(Glushkov *g, Ast *ast);
+
+/* the positions of r{min,max}, new ones for each copy, see `count_fragment` */
+static Positions repeat_positions(Glushkov *g, Ast *r, unsigned int min,
+                                 int max) {
+  unsigned int copies = max < 0 ? (min > 0 ? min : 1) : (unsigned int)max;
+  Positions p = {new_states(), new_states(), true};
+  for (unsigned int i = 0; i < copies; ++i) {
+    Positions copy = glushkov_positions(g, r);
+    if (max < 0 && i + 1 == copies)
+      connect_positions(g, copy.last, copy.first);
+    if (i >= min)
+      copy.nullable = true;
+    p = concat_positions(g, p, copy);
   }
-  free(lexer);
-  free(parser);
-  return nfa;
+  return p;
 }
 
-NFA *build_many(char **patterns, size_t len) {
-  g_state_counts = 0;
-  NFA *nfa = new_nfa();
+static Positions glushkov_positions(Glushkov *g, Ast *ast) {
+  switch (ast->type) {
+  case LiteralNode:
+  case SetNode: {
+    State state = increase_state_counts(g->b);
+    if (state >= g->labels_capacity) {
+      g->labels_capacity = g->labels_capacity * 2 + 16;
+      g->labels =
+          (Label **)realloc(g->labels, g->labels_capacity * sizeof(Label *));
+    }
+    g->labels[state] = position_label(g->nfa->arena, ast);
+    Positions p = {new_states(), new_states(), false};
+    push_state(p.first, state);
+    push_state(p.last, state);
+    return p;
+  }
+
+  case AndNode: {
+    Positions left = glushkov_positions(g, ast->data.AstAnd.r1);
+    Positions right = glushkov_positions(g, ast->data.AstAnd.r2);
+    return concat_positions(g, left, right);
+  }
+
+  case OrNode: {
+    Positions left = glushkov_positions(g, ast->data.AstOr.r1);
+    Positions right = glushkov_positions(g, ast->data.AstOr.r2);
+    push_all_states(left.first, right.first);
+    push_all_states(left.last, right.last);
+    free_states(right.first);
+    free_states(right.last);
+    left.nullable = left.nullable || right.nullable;
+    return left;
+  }
+
+  case RepeatNode: {
+    Positions body = glushkov_positions(g, ast->data.AstRepeat.r);
+    connect_positions(g, body.last, body.first);
+    body.nullable = true;
+    return body;
+  }
+
+  case SurroundNode:
+    return glushkov_positions(g, ast->data.AstSurround.r);
+
+  case CountNode:
+    return repeat_positions(g, ast->data.AstCount.r, ast->data.AstCount.min,
+                            ast->data.AstCount.max);
+
+  default:
+    exit(1);
+  }
+}
+
+/* make a state accept a pattern, unless it accepts an earlier one */
+static void push_target(NFA *nfa, State state, int pattern) {
+  if (have_state(nfa->target_states, state))
+    return;
+  push_state(nfa->target_states, state);
+  nfa->target_patterns = (int *)realloc(
+      nfa->target_patterns, nfa->target_states->len * sizeof(int));
+  nfa->target_patterns[nfa->target_states->len - 1] = pattern;
+}
+
+/* build the NFA of ASTs with the Glushkov construction */
+static void glushkov_nfa(NFA *nfa, Ast **asts, size_t len) {
+  Builder b = {0, nfa};
+  Glushkov g = {&b, nfa, NULL, 0};
+  nfa->target_states = new_states();
+  nfa->target_patterns = (int *)malloc(sizeof(int));
+  States *start = new_states();
+  push_state(start, increase_state_counts(&b));
+
+  for (size_t i = 0; i < len; ++i) {
+    Positions p = glushkov_positions(&g, asts[i]);
+    connect_positions(&g, start, p.first);
+    if (p.nullable)
+      push_target(nfa, start->states[0], i);
+    for (size_t j = 0; j < p.last->len; ++j)
+      push_target(nfa, p.last->states[j], i);
+    free_states(p.first);
+    free_states(p.last);
+  }
+  nfa->states_count = b.state_counts;
+  free_states(start);
+  free(g.labels);
+}
+
+/* build the NFA of ASTs with the Thompson construction */
+static void thompson_nfa(NFA *nfa, Ast **asts, size_t len) {
+  Builder b = {0, nfa};
   nfa->target_states = new_states();
-  State start = increase_state_counts();
+  State start = increase_state_counts(&b);
 
   for (size_t i = 0; i < len; ++i) {
-    State sub_start = get_state_counts();
-    NFA *sub_nfa = build(patterns[i]);
-    move_edges(nfa, sub_nfa);
-    add_epsilon(nfa, start, sub_start);
-    push_state(nfa->target_states, sub_nfa->target_states->states[0]);
-    free(sub_nfa);
+    NFAFragment fragment = ast2nfa_fragment(&b, asts[i]);
+    add_epsilon(nfa, start, fragment.start);
+    push_state(nfa->target_states, fragment.accept);
   }
+  nfa->states_count = b.state_counts;
+}
+
+/*
+ * build an NFA from patterns with a construction, the first pattern has the
+ * highest priority. small patterns also get a bit-parallel matcher.
+ */
+NFA *build_many_with(char **patterns, size_t len, Construction construction) {
+  NFA *nfa = new_nfa();
+  Ast **asts = parse_patterns(nfa, patterns, len);
+  BitNFA *bits = new_bitnfa(asts, len);
 
+  if (construction == GLUSHKOV)
+    glushkov_nfa(nfa, asts, len);
+  else
+    thompson_nfa(nfa, asts, len);
+  free(asts);
+  nfa->bits = bits;
+  finalize_nfa(nfa);
   return nfa;
 }
+
+/* build an NFA from a pattern with a construction */
+NFA *build_with(char *pattern, Construction construction) {
+  if (construction == GLUSHKOV)
+    return build_many_with(&pattern, 1, GLUSHKOV);
+
+  /* without the start state of `build_many` */
+  NFA *nfa = new_nfa();
+  Builder b = {0, nfa};
+  Ast **ast = parse_patterns(nfa, &pattern, 1);
+  NFAFragment fragment = ast2nfa_fragment(&b, *ast);
+  nfa->states_count = b.state_counts;
+  nfa->target_states = new_states();
+  push_state(nfa->target_states, fragment.accept);
+  nfa->bits = new_bitnfa(ast, 1);
+  free(ast);
+  finalize_nfa(nfa);
+  return nfa;
+}
+
+NFA *build(char *pattern) { return build_with(pattern, DEFAULT_CONSTRUCTION); }
+
+NFA *build_many(char **patterns, size_t len) {
+  return build_many_with(patterns, len, DEFAULT_CONSTRUCTION);
+}
@@ -1,4 +1,6 @@
+#include "../util/arena.c"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 
 typedef enum AstType {
@@ -8,13 +10,29 @@ typedef enum AstType {
   OrNode,
   RepeatNode,
   SurroundNode,
+  CountNode,
 } AstType;
 
 typedef struct Ast Ast;
-typedef struct Vector_char Vector_char;
+typedef struct CharSet CharSet;
+
+/* pre-define */
+bool equal_charset(CharSet *a, CharSet *b);
+CharSet *new_charset_in(Arena *arena);
+void add_char(CharSet *set, char c);
+void union_charset(CharSet *set, CharSet *other);
+size_t hash_charset(CharSet *set);
 
 typedef struct Ast {
-  enum { AstLiteral, AstSet, AstAnd, AstOr, AstRepeat, AstSurround } type;
+  enum {
+    AstLiteral,
+    AstSet,
+    AstAnd,
+    AstOr,
+    AstRepeat,
+    AstSurround,
+    AstCount
+  } type;
 
   union {
     struct AstLiteral {
@@ -22,8 +40,7 @@ typedef struct Ast {
     } AstLiteral;
 
     struct AstSet {
-      Vector_char *set;
-      bool is_neg;
+      CharSet *set;
     } AstSet;
 
     struct AstAnd {
@@ -43,54 +60,53 @@ typedef struct Ast {
     struct AstSurround {
       Ast *r;
     } AstSurround;
+
+    /* r{min,max}, without upper bound if max < 0: r? is r{0,1}, r+ is r{1,} */
+    struct AstCount {
+      Ast *r;
+      unsigned int min;
+      int max;
+    } AstCount;
   } data;
 } Ast;
 
-Ast *new_ast(Ast ast) {
-  Ast *p = malloc(sizeof(Ast));
-  if (p != NULL)
-    *p = ast;
+/* nodes are allocated from an arena, and freed with it */
+Ast *new_ast(Arena *arena, Ast ast) {
+  Ast *p = (Ast *)arena_alloc(arena, sizeof(Ast));
+  *p = ast;
   return p;
 }
 
-#define NEW_AST(tag, ...)                                                      \
-  new_ast((Ast){tag, {.tag = (struct tag){__VA_ARGS__}}})
+#define NEW_AST(arena, tag, ...)                                               \
+  new_ast(arena, (Ast){tag, {.tag = (struct tag){__VA_ARGS__}}})
 
 /* newer */
-static Ast *new_ast_literal(char value) { return NEW_AST(AstLiteral, value); }
+static Ast *new_ast_literal(Arena *arena, char value) {
+  return NEW_AST(arena, AstLiteral, value);
+}
 
-static Ast *new_ast_set(Vector_char *set, bool is_neg) {
-  return NEW_AST(AstSet, set, is_neg);
+static Ast *new_ast_set(Arena *arena, CharSet *set) {
+  return NEW_AST(arena, AstSet, set);
 }
 
-static Ast *new_ast_and(Ast *r1, Ast *r2) { return NEW_AST(AstAnd, r1, r2); }
+static Ast *new_ast_and(Arena *arena, Ast *r1, Ast *r2) {
+  return NEW_AST(arena, AstAnd, r1, r2);
+}
 
-static Ast *new_ast_or(Ast *r1, Ast *r2) { return NEW_AST(AstOr, r1, r2); }
+static Ast *new_ast_or(Arena *arena, Ast *r1, Ast *r2) {
+  return NEW_AST(arena, AstOr, r1, r2);
+}
 
-static Ast *new_ast_repeat(Ast *r) { return NEW_AST(AstRepeat, r); }
+static Ast *new_ast_repeat(Arena *arena, Ast *r) {
+  return NEW_AST(arena, AstRepeat, r);
+}
 
-static Ast *new_ast_surround(Ast *r) { return NEW_AST(AstSurround, r); }
+static Ast *new_ast_surround(Arena *arena, Ast *r) {
+  return NEW_AST(arena, AstSurround, r);
+}
 
-/* clone */
-static Ast *clone_ast(Ast *r) {
-  if (r == NULL)
-    return NULL;
-  switch (r->type) {
-  case LiteralNode:
-    return new_ast_literal(r->data.AstLiteral.value);
-  case SetNode:
-    return new_ast_set(r->data.AstSet.set, r->data.AstSet.is_neg);
-  case AndNode:
-    return new_ast_and(clone_ast(r->data.AstAnd.r1),
-                       clone_ast(r->data.AstAnd.r2));
-  case OrNode:
-    return new_ast_or(clone_ast(r->data.AstOr.r1), clone_ast(r->data.AstOr.r2));
-  case RepeatNode:
-    return new_ast_repeat(clone_ast(r->data.AstRepeat.r));
-  case SurroundNode:
-    return clone_ast(clone_ast(r->data.AstSurround.r));
-  }
-  return NULL; /* unreachable */
+static Ast *new_ast_count(Arena *arena, Ast *r, unsigned int min, int max) {
+  return NEW_AST(arena, AstCount, r, min, max);
 }
 
 /* comparison */
@@ -106,7 +122,7 @@ bool equal_ast(Ast *a, Ast *b) {
   case LiteralNode:
     return a->data.AstLiteral.value == b->data.AstLiteral.value;
   case SetNode:
-    return true; /* ignore it */
+    return equal_charset(a->data.AstSet.set, b->data.AstSet.set);
   case AndNode:
     return equal_ast(a->data.AstAnd.r1, b->data.AstAnd.r1) &&
            equal_ast(a->data.AstAnd.r2, b->data.AstAnd.r2);
@@ -117,36 +133,463 @@ bool equal_ast(Ast *a, Ast *b) {
     return equal_ast(a->data.AstRepeat.r, b->data.AstRepeat.r);
   case SurroundNode:
     return equal_ast(a->data.AstSurround.r, b->data.AstSurround.r);
+  case CountNode:
+    return a->data.AstCount.min == b->data.AstCount.min &&
+           a->data.AstCount.max == b->data.AstCount.max &&
+           equal_ast(a->data.AstCount.r, b->data.AstCount.r);
   default:
     return false;
   }
 }
 
-/* free */
-void free_ast(Ast *node) {
-  if (node == NULL)
-    return;
-  switch (node->type) {
+/* number of nodes of an AST, a shared node is counted at each use */
+size_t count_ast(Ast *ast) {
+  switch (ast->type) {
+  case AndNode:
+    return 1 + count_ast(ast->data.AstAnd.r1) + count_ast(ast->data.AstAnd.r2);
+  case OrNode:
+    return 1 + count_ast(ast->data.AstOr.r1) + count_ast(ast->data.AstOr.r2);
+  case RepeatNode:
+    return 1 + count_ast(ast->data.AstRepeat.r);
+  case SurroundNode:
+    return 1 + count_ast(ast->data.AstSurround.r);
+  case CountNode:
+    return 1 + count_ast(ast->data.AstCount.r);
+  default:
+    return 1;
+  }
+}
+
+/*
+ * number of chars and sets of an AST once its counts are expanded, or
+ * `limit` + 1 if there are more, so that nested counts don't overflow
+ */
+size_t count_positions(Ast *ast, size_t limit) {
+  size_t count;
+  switch (ast->type) {
   case LiteralNode:
-    /* nothing to free */
-    break;
   case SetNode:
-    /* nothing to free */
-    break;
+    return 1;
   case AndNode:
-    free_ast(node->data.AstAnd.r1);
-    free_ast(node->data.AstAnd.r2);
-    break;
   case OrNode:
-    free_ast(node->data.AstOr.r1);
-    free_ast(node->data.AstOr.r2);
-    break;
+    /* AstAnd and AstOr have the same layout */
+    count = count_positions(ast->data.AstAnd.r1, limit) +
+            count_positions(ast->data.AstAnd.r2, limit);
+    return count > limit ? limit + 1 : count;
   case RepeatNode:
-    free_ast(node->data.AstRepeat.r);
-    break;
+    return count_positions(ast->data.AstRepeat.r, limit);
   case SurroundNode:
-    free_ast(node->data.AstSurround.r);
-    break;
+    return count_positions(ast->data.AstSurround.r, limit);
+  case CountNode: {
+    /* each copy has its own positions, see `count_fragment` */
+    int max = ast->data.AstCount.max;
+    unsigned int min = ast->data.AstCount.min;
+    unsigned int copies = max < 0 ? (min > 0 ? min : 1) : (unsigned int)max;
+    count = count_positions(ast->data.AstCount.r, limit);
+    if (copies > 0 && count > limit / copies)
+      return limit + 1;
+    return count * copies;
+  }
+  default:
+    return 0;
+  }
+}
+
+/*
+ * simplification: ASTs are rebuilt bottom-up into an arena, matching the
+ * same strings with fewer nodes. groups are dropped, (r*)* is r*, a|a is a,
+ * single chars of an alternation are one set, and common prefixes of
+ * alternatives are factored: ab|ac|a is a([bc])?.
+ *
+ * the nodes are hash-consed, each distinct node is built once and shared, so
+ * that two subtrees are equal if and only if they are the same pointer.
+ */
+
+/* the node counts of `simplify_asts` */
+typedef struct AstStats {
+  size_t before; /* nodes parsed */
+  size_t after;  /* distinct nodes left */
+} AstStats;
+
+typedef struct Simplifier {
+  Arena *arena; /* of the simplified nodes and sets */
+  Ast **table;  /* distinct nodes, open addressing */
+  size_t capacity;
+  size_t len;
+} Simplifier;
+
+static size_t hash_pointer(void *p) {
+  return (size_t)p * 0x9E3779B97F4A7C15ull >> 16;
+}
+
+/* hash of a node whose children are already distinct */
+static size_t hash_node(Ast *ast) {
+  size_t h = ast->type;
+  switch (ast->type) {
+  case LiteralNode:
+    return h * 31 + (unsigned char)ast->data.AstLiteral.value;
+  case SetNode:
+    return h * 31 + hash_charset(ast->data.AstSet.set);
+  case AndNode:
+  case OrNode:
+    /* AstAnd and AstOr have the same layout */
+    return (h * 31 + hash_pointer(ast->data.AstAnd.r1)) * 31 +
+           hash_pointer(ast->data.AstAnd.r2);
+  case RepeatNode:
+    return h * 31 + hash_pointer(ast->data.AstRepeat.r);
+  case CountNode:
+    return ((h * 31 + hash_pointer(ast->data.AstCount.r)) * 31 +
+            ast->data.AstCount.min) *
+               31 +
+           (size_t)ast->data.AstCount.max;
+  default:
+    return h;
+  }
+}
+
+/* if two nodes whose children are already distinct are equal */
+static bool same_node(Ast *a, Ast *b) {
+  if (a->type != b->type)
+    return false;
+  switch (a->type) {
+  case LiteralNode:
+    return a->data.AstLiteral.value == b->data.AstLiteral.value;
+  case SetNode:
+    return equal_charset(a->data.AstSet.set, b->data.AstSet.set);
+  case AndNode:
+  case OrNode:
+    return a->data.AstAnd.r1 == b->data.AstAnd.r1 &&
+           a->data.AstAnd.r2 == b->data.AstAnd.r2;
+  case RepeatNode:
+    return a->data.AstRepeat.r == b->data.AstRepeat.r;
+  case CountNode:
+    return a->data.AstCount.r == b->data.AstCount.r &&
+           a->data.AstCount.min == b->data.AstCount.min &&
+           a->data.AstCount.max == b->data.AstCount.max;
+  default:
+    return false;
+  }
+}
+
+/* the distinct node equal to `ast`, built if there is none yet */
+static Ast *intern_ast(Simplifier *s, Ast ast) {
+  if (s->len * 2 >= s->capacity) {
+    size_t capacity = s->capacity > 0 ? s->capacity * 2 : 64;
+    Ast **table = (Ast **)calloc(capacity, sizeof(Ast *));
+    for (size_t i = 0; i < s->capacity; ++i) {
+      if (s->table[i] == NULL)
+        continue;
+      size_t j = hash_node(s->table[i]) & (capacity - 1);
+      while (table[j] != NULL)
+        j = (j + 1) & (capacity - 1);
+      table[j] = s->table[i];
+    }
+    free(s->table);
+    s->table = table;
+    s->capacity = capacity;
+  }
+  size_t i = hash_node(&ast) & (s->capacity - 1);
+  for (; s->table[i] != NULL; i = (i + 1) & (s->capacity - 1))
+    if (same_node(s->table[i], &ast))
+      return s->table[i];
+  s->len++;
+  return s->table[i] = new_ast(s->arena, ast);
+}
+
+/* the factors of a concatenation, or the alternatives of an alternation */
+typedef struct AstList {
+  Ast **nodes;
+  size_t len;
+  size_t capacity;
+} AstList;
+
+static void push_ast(AstList *list, Ast *ast) {
+  if (list->len == list->capacity) {
+    list->capacity = list->capacity * 2 + 8;
+    list->nodes = (Ast **)realloc(list->nodes, list->capacity * sizeof(Ast *));
+  }
+  list->nodes[list->len++] = ast;
+}
+
+/* r1 r2 r3 ... as r1 (r2 (r3 ...)), so that the first factor is the head */
+static Ast *join_and(Simplifier *s, Ast **factors, size_t len) {
+  Ast *ast = factors[len - 1];
+  for (size_t i = len - 1; i-- > 0;)
+    ast = intern_ast(s, (Ast){AstAnd, {.AstAnd = {factors[i], ast}}});
+  return ast;
+}
+
+static Ast *join_or(Simplifier *s, Ast **alternatives, size_t len) {
+  Ast *ast = alternatives[len - 1];
+  for (size_t i = len - 1; i-- > 0;)
+    ast = intern_ast(s, (Ast){AstOr, {.AstOr = {alternatives[i], ast}}});
+  return ast;
+}
+
+/* the first factor of a simplified node, and what follows it or NULL */
+static Ast *ast_head(Ast *ast) {
+  return ast->type == AstAnd ? ast->data.AstAnd.r1 : ast;
+}
+
+static Ast *ast_tail(Ast *ast) {
+  return ast->type == AstAnd ? ast->data.AstAnd.r2 : NULL;
+}
+
+/* a node and its place among the alternatives of an alternation */
+typedef struct IndexedAst {
+  Ast *ast;
+  size_t index;
+} IndexedAst;
+
+/* by node, then by place */
+static int compare_nodes(const void *a, const void *b) {
+  const IndexedAst *x = (const IndexedAst *)a, *y = (const IndexedAst *)b;
+  if (x->ast != y->ast)
+    return x->ast < y->ast ? -1 : 1;
+  return x->index < y->index ? -1 : x->index > y->index;
+}
+
+static int compare_indexes(const void *a, const void *b) {
+  const IndexedAst *x = (const IndexedAst *)a, *y = (const IndexedAst *)b;
+  return x->index < y->index ? -1 : x->index > y->index;
+}
+
+/* add the chars of a char or set node to a set */
+static void add_to_set(CharSet *set, Ast *leaf) {
+  if (leaf->type == AstLiteral)
+    add_char(set, leaf->data.AstLiteral.value);
+  else
+    union_charset(set, leaf->data.AstSet.set);
+}
+
+static Ast *simplify_count(Simplifier *s, Ast *r, unsigned int min, int max);
+
+/*
+ * the alternation of simplified nodes: alternatives with the same head are
+ * factored, in the place of the first of them, and single chars are merged
+ */
+static Ast *simplify_or(Simplifier *s, Ast **nodes, size_t len) {
+  AstList alternatives = {NULL, 0, 0};
+  for (size_t i = 0; i < len; ++i) {
+    Ast *ast = nodes[i];
+    for (; ast->type == AstOr; ast = ast->data.AstOr.r2)
+      push_ast(&alternatives, ast->data.AstOr.r1);
+    push_ast(&alternatives, ast);
+  }
+
+  /* group by head, a group is then in the place of its first alternative */
+  size_t n = alternatives.len;
+  IndexedAst *heads = (IndexedAst *)malloc(n * sizeof(IndexedAst));
+  for (size_t i = 0; i < n; ++i)
+    heads[i] = (IndexedAst){ast_head(alternatives.nodes[i]), i};
+  qsort(heads, n, sizeof(IndexedAst), compare_nodes);
+  IndexedAst *groups = (IndexedAst *)malloc(n * sizeof(IndexedAst));
+  size_t groups_len = 0;
+  for (size_t i = 0; i < n;) {
+    size_t end = i;
+    while (end < n && heads[end].ast == heads[i].ast)
+      ++end;
+    Ast *factored = alternatives.nodes[heads[i].index];
+    if (end - i > 1) {
+      AstList tails = {NULL, 0, 0};
+      bool empty = false; /* if an alternative is the head alone */
+      for (size_t j = i; j < end; ++j) {
+        Ast *tail = ast_tail(alternatives.nodes[heads[j].index]);
+        if (tail == NULL)
+          empty = true;
+        else
+          push_ast(&tails, tail);
+      }
+      factored = heads[i].ast;
+      if (tails.len > 0) {
+        Ast *rest = simplify_or(s, tails.nodes, tails.len);
+        if (empty)
+          rest = simplify_count(s, rest, 0, 1);
+        Ast *factors[] = {factored, rest};
+        factored = join_and(s, factors, 2);
+      }
+      free(tails.nodes);
+    }
+    groups[groups_len++] = (IndexedAst){factored, heads[i].index};
+    i = end;
+  }
+  qsort(groups, groups_len, sizeof(IndexedAst), compare_indexes);
+
+  /* single chars and sets as one set, in the place of the first of them */
+  alternatives.len = 0;
+  Ast *first_char = NULL;
+  size_t first_place = 0;
+  CharSet *set = NULL;
+  for (size_t i = 0; i < groups_len; ++i) {
+    Ast *ast = groups[i].ast;
+    if (ast->type != AstLiteral && ast->type != AstSet) {
+      push_ast(&alternatives, ast);
+    } else if (first_char == NULL) {
+      first_char = ast;
+      first_place = alternatives.len;
+      push_ast(&alternatives, ast);
+    } else {
+      if (set == NULL) {
+        set = new_charset_in(s->arena);
+        add_to_set(set, first_char);
+      }
+      add_to_set(set, ast);
+    }
+  }
+  if (set != NULL)
+    alternatives.nodes[first_place] =
+        intern_ast(s, (Ast){AstSet, {.AstSet = {set}}});
+
+  Ast *ast = join_or(s, alternatives.nodes, alternatives.len);
+  free(alternatives.nodes);
+  free(heads);
+  free(groups);
+  return ast;
+}
+
+static bool is_quantifier(unsigned int min, int max) {
+  return min <= 1 && (max == 1 || max < 0);
+}
+
+/* r{min,max} of a simplified r */
+static Ast *simplify_count(Simplifier *s, Ast *r, unsigned int min, int max) {
+  if (min == 1 && max == 1)
+    return r;
+  if (r->type == AstRepeat && max != 0)
+    return r; /* (r*)+ is r* */
+  if (r->type == AstCount &&
+      is_quantifier(r->data.AstCount.min, r->data.AstCount.max) &&
+      is_quantifier(min, max)) {
+    /* (r?)? is r?, (r+)+ is r+, and (r?)+ and (r+)? are r* */
+    Ast *inner = r;
+    r = inner->data.AstCount.r;
+    min = min < inner->data.AstCount.min ? min : inner->data.AstCount.min;
+    max = max < 0 || inner->data.AstCount.max < 0 ? -1 : 1;
+  }
+  if (min == 0 && max < 0)
+    return intern_ast(s, (Ast){AstRepeat, {.AstRepeat = {r}}});
+  return intern_ast(s, (Ast){AstCount, {.AstCount = {r, min, max}}});
+}
+
+static Ast *simplify_ast(Simplifier *s, Ast *ast);
+
+/* push the simplified factors of a concatenation */
+static void simplify_factors(Simplifier *s, Ast *ast, AstList *factors) {
+  while (ast->type == AstSurround)
+    ast = ast->data.AstSurround.r;
+  if (ast->type == AstAnd) {
+    simplify_factors(s, ast->data.AstAnd.r1, factors);
+    simplify_factors(s, ast->data.AstAnd.r2, factors);
+    return;
+  }
+  Ast *factor = simplify_ast(s, ast);
+  for (; factor->type == AstAnd; factor = factor->data.AstAnd.r2)
+    push_ast(factors, factor->data.AstAnd.r1);
+  push_ast(factors, factor);
+}
+
+/* push the simplified alternatives of an alternation */
+static void simplify_alternatives(Simplifier *s, Ast *ast, AstList *list) {
+  while (ast->type == AstSurround)
+    ast = ast->data.AstSurround.r;
+  if (ast->type == AstOr) {
+    simplify_alternatives(s, ast->data.AstOr.r1, list);
+    simplify_alternatives(s, ast->data.AstOr.r2, list);
+    return;
+  }
+  push_ast(list, simplify_ast(s, ast));
+}
+
+static Ast *simplify_ast(Simplifier *s, Ast *ast) {
+  switch (ast->type) {
+  case LiteralNode:
+    return intern_ast(s, *ast);
+
+  case SetNode: {
+    CharSet *set = new_charset_in(s->arena);
+    union_charset(set, ast->data.AstSet.set);
+    return intern_ast(s, (Ast){AstSet, {.AstSet = {set}}});
+  }
+
+  case AndNode: {
+    AstList factors = {NULL, 0, 0};
+    simplify_factors(s, ast, &factors);
+    Ast *result = join_and(s, factors.nodes, factors.len);
+    free(factors.nodes);
+    return result;
+  }
+
+  case OrNode: {
+    AstList alternatives = {NULL, 0, 0};
+    simplify_alternatives(s, ast, &alternatives);
+    Ast *result = simplify_or(s, alternatives.nodes, alternatives.len);
+    free(alternatives.nodes);
+    return result;
+  }
+
+  case RepeatNode: {
+    Ast *r = simplify_ast(s, ast->data.AstRepeat.r);
+    /* (r*)*, (r?)* and (r+)* are r* */
+    if (r->type == AstRepeat)
+      return r;
+    if (r->type == AstCount && r->data.AstCount.min <= 1 &&
+        r->data.AstCount.max != 0)
+      r = r->data.AstCount.r;
+    return intern_ast(s, (Ast){AstRepeat, {.AstRepeat = {r}}});
+  }
+
+  case SurroundNode:
+    return simplify_ast(s, ast->data.AstSurround.r);
+
+  case CountNode:
+    return simplify_count(s, simplify_ast(s, ast->data.AstCount.r),
+                          ast->data.AstCount.min, ast->data.AstCount.max);
+
+  default:
+    exit(1);
+  }
+}
+
+/* distinct nodes reachable from the ASTs, `seen` is a table of them */
+static size_t count_distinct(Ast *ast, Ast **seen, size_t capacity) {
+  size_t i = hash_pointer(ast) & (capacity - 1);
+  for (; seen[i] != NULL; i = (i + 1) & (capacity - 1))
+    if (seen[i] == ast)
+      return 0;
+  seen[i] = ast;
+  switch (ast->type) {
+  case AndNode:
+  case OrNode:
+    return 1 + count_distinct(ast->data.AstAnd.r1, seen, capacity) +
+           count_distinct(ast->data.AstAnd.r2, seen, capacity);
+  case RepeatNode:
+    return 1 + count_distinct(ast->data.AstRepeat.r, seen, capacity);
+  case CountNode:
+    return 1 + count_distinct(ast->data.AstCount.r, seen, capacity);
+  default:
+    return 1;
+  }
+}
+
+/*
+ * replace ASTs by simplified ones built in `arena`, sharing their equal
+ * subtrees. the node counts are put in `stats` unless it is NULL.
+ */
+void simplify_asts(Arena *arena, Ast **asts, size_t len, AstStats *stats) {
+  Simplifier s = {arena, NULL, 0, 0};
+  size_t before = 0;
+  for (size_t i = 0; i < len; ++i) {
+    before += count_ast(asts[i]);
+    asts[i] = simplify_ast(&s, asts[i]);
+  }
+  if (stats != NULL) {
+    /* nodes replaced while factoring are in the table, but not used */
+    Ast **seen = (Ast **)calloc(s.capacity, sizeof(Ast *));
+    stats->before = before;
+    stats->after = 0;
+    for (size_t i = 0; i < len; ++i)
+      stats->after += count_distinct(asts[i], seen, s.capacity);
+    free(seen);
   }
-  free(node);
+  free(s.table);
 }
@@ -1,3 +1,4 @@
+#include <stdbool.h>
 #include <stdlib.h>
 
 /*
@@ -14,6 +15,8 @@ typedef enum TokenType {
   DOT,
   PLUS,
   ASTERISK,
+  QUESTION,
+  LBRACE, /* only before a count like {2}, {2,} or {2,5} */
   BAR,
   BACK_SLASH,
   LITERAL,
@@ -25,18 +28,15 @@ typedef struct Token {
   char value; /* valid only for LITERAL type */
 } Token;
 
-/* create a token */
-Token *new_token(TokenType type, char value) {
-  Token *token = (Token *)malloc(sizeof(Token));
-  token->type = type;
-  token->value = value;
-  return token;
+/* a token, kept by value in the lexer */
+static Token new_token(TokenType type, char value) {
+  return (Token){type, value};
 }
 
 typedef struct Lexer {
   char *pattern;
   char *current_char;
-  Token *current_token;
+  Token current_token; /* overwritten by each `get_next_token` */
 } Lexer;
 
 /* create a new lexer from pattern string */
@@ -44,14 +44,23 @@ Lexer *new_lexer(char *pattern) {
   Lexer *lexer = (Lexer *)malloc(sizeof(Lexer));
   lexer->pattern = pattern;
   lexer->current_char = lexer->pattern;
-  lexer->current_token = NULL;
+  lexer->current_token = new_token(END, '\0');
   return lexer;
 }
 
-Token *get_next_token(Lexer *lexer) {
-  if (lexer->current_token != NULL)
-    free(lexer->current_token);
+/* if the text at `p` is a count, the rest of `{m}`, `{m,}` or `{m,n}` */
+static bool is_count(char *p) {
+  if (*p < '0' || *p > '9')
+    return false;
+  while (*p >= '0' && *p <= '9')
+    ++p;
+  if (*p == ',')
+    for (++p; *p >= '0' && *p <= '9'; ++p)
+      ;
+  return *p == '}';
+}
 
+Token *get_next_token(Lexer *lexer) {
   char current_char = *lexer->current_char;
   switch (current_char) {
   case '\0':
@@ -84,6 +93,16 @@ Token *get_next_token(Lexer *lexer) {
   case '*':
     lexer->current_token = new_token(ASTERISK, '*');
     break;
+  case '?':
+    lexer->current_token = new_token(QUESTION, '?');
+    break;
+  case '{':
+    /* a brace which doesn't start a count is a literal, like in lex */
+    if (is_count(lexer->current_char + 1))
+      lexer->current_token = new_token(LBRACE, '{');
+    else
+      lexer->current_token = new_token(LITERAL, '{');
+    break;
   case '|':
     lexer->current_token = new_token(BAR, '|');
     break;
@@ -96,5 +115,5 @@ Token *get_next_token(Lexer *lexer) {
   }
   ++(lexer->current_char);
 
-  return lexer->current_token;
+  return &lexer->current_token;
 }
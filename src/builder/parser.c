@@ -5,18 +5,27 @@
 #include "ast.c"
 #include "lexer.c"
 
+/* the largest count of `{m,n}`, each one repeats the NFA of its AST */
+#define MAX_COUNT 1000
+/* the most chars and sets of a pattern once nested counts are multiplied */
+#define MAX_POSITIONS 100000
+
 /* pre-define */
-Vector_char *new_vector_char();
-int push_vector_char(Vector_char *vec, char value);
+CharSet *new_charset_in(Arena *arena);
+void add_char(CharSet *set, char c);
+void add_range(CharSet *set, char from, char to);
+void negate_charset(CharSet *set);
 
 typedef struct Parser {
   Lexer *lexer;
   Token *current_token;
+  Arena *arena; /* of the AST nodes and sets */
 } Parser;
 
-Parser *new_parser(Lexer *lexer) {
+Parser *new_parser(Lexer *lexer, Arena *arena) {
   Parser *parser = (Parser *)malloc(sizeof(Parser));
   parser->lexer = lexer;
+  parser->arena = arena;
   parser->current_token = get_next_token(lexer);
   return parser;
 }
@@ -69,7 +78,7 @@ static Ast *parse_expr(Parser *parser) {
   while (parser->current_token->type == BAR) {
     eat(parser, BAR);
     Ast *right = parse_term(parser);
-    node = new_ast_or(node, right);
+    node = new_ast_or(parser->arena, node, right);
   }
   return node;
 }
@@ -86,25 +95,77 @@ static Ast *parse_term(Parser *parser) {
          parser->current_token->type == LPAREN ||
          parser->current_token->type == BACK_SLASH) {
     Ast *right = parse_factor(parser);
-    node = new_ast_and(node, right);
+    node = new_ast_and(parser->arena, node, right);
   }
   return node;
 }
 
+/* read a number of a count, and check it is not too large */
+static int parse_number(Parser *parser) {
+  int number = 0;
+  while (parser->current_token->type == LITERAL &&
+         parser->current_token->value >= '0' &&
+         parser->current_token->value <= '9') {
+    number = number * 10 + (parser->current_token->value - '0');
+    if (number > MAX_COUNT) {
+      printf("count larger than %d\n", MAX_COUNT);
+      exit(1);
+    }
+    eat(parser, LITERAL);
+  }
+  return number;
+}
+
+/*
+ * count := '{' number '}'
+ *        | '{' number ',' '}'
+ *        | '{' number ',' number '}'
+ */
+static Ast *parse_count(Parser *parser, Ast *node) {
+  eat(parser, LBRACE);
+  int min = parse_number(parser);
+  int max = min;
+  if (parser->current_token->value == ',') {
+    eat(parser, LITERAL);
+    max = parser->current_token->value == '}' ? -1 : parse_number(parser);
+  }
+  if (parser->current_token->value != '}' || (max >= 0 && max < min)) {
+    printf("wrong count {%d,%d}\n", min, max);
+    exit(1);
+  }
+  eat(parser, LITERAL);
+  return new_ast_count(parser->arena, node, min, max);
+}
+
 /*
- * factor := base '*'
- *           base '+'
+ * factor := base ('*' | '+' | '?' | count)*
+ *
+ * the repeated AST is shared, not copied: `+`, `?` and counts are expanded
+ * when building the NFA
  */
 static Ast *parse_factor(Parser *parser) {
   Ast *node = parse_base(parser);
-  if (parser->current_token->type == ASTERISK) {
-    eat(parser, ASTERISK);
-    node = new_ast_repeat(node);
-  } else if (parser->current_token->type == PLUS) {
-    eat(parser, PLUS);
-    node = new_ast_and(clone_ast(node), new_ast_repeat(node));
+  for (;;) {
+    switch (parser->current_token->type) {
+    case ASTERISK:
+      eat(parser, ASTERISK);
+      node = new_ast_repeat(parser->arena, node);
+      break;
+    case PLUS:
+      eat(parser, PLUS);
+      node = new_ast_count(parser->arena, node, 1, -1);
+      break;
+    case QUESTION:
+      eat(parser, QUESTION);
+      node = new_ast_count(parser->arena, node, 0, 1);
+      break;
+    case LBRACE:
+      node = parse_count(parser, node);
+      break;
+    default:
+      return node;
+    }
   }
-  return node;
 }
 
 /*
@@ -119,22 +180,23 @@ static Ast *parse_base(Parser *parser) {
   case LITERAL: {
     char value = parser->current_token->value;
     eat(parser, LITERAL);
-    return new_ast_literal(value);
+    return new_ast_literal(parser->arena, value);
   }
   case CARET: {
     char value = parser->current_token->value;
     eat(parser, CARET);
-    return new_ast_literal(value);
+    return new_ast_literal(parser->arena, value);
   }
   case BACK_SLASH: {
-    return new_ast_literal(eat_escape_char(parser));
+    return new_ast_literal(parser->arena, eat_escape_char(parser));
   }
   case DOT: {
     /* anything but newline */
     eat(parser, DOT);
-    Vector_char *set = new_vector_char();
-    push_vector_char(set, '\n');
-    return new_ast_set(set, true);
+    CharSet *set = new_charset_in(parser->arena);
+    add_char(set, '\n');
+    negate_charset(set);
+    return new_ast_set(parser->arena, set);
   }
   case LBRACKET: {
     eat(parser, LBRACKET);
@@ -146,7 +208,7 @@ static Ast *parse_base(Parser *parser) {
     eat(parser, LPAREN);
     Ast *node = parse_expr(parser);
     eat(parser, RPAREN);
-    return new_ast_surround(node);
+    return new_ast_surround(parser->arena, node);
   }
   default: {
     printf("unexpected token: %d\n", parser->current_token->type);
@@ -155,13 +217,28 @@ static Ast *parse_base(Parser *parser) {
   }
 }
 
+/* a char of a range: any token but END is the char it was lexed from */
+static char eat_range_char(Parser *parser) {
+  if (parser->current_token->type == BACK_SLASH)
+    return eat_escape_char(parser);
+  if (parser->current_token->type == END) {
+    printf("unterminated range\n");
+    exit(1);
+  }
+  char value = parser->current_token->value;
+  parser->current_token = get_next_token(parser->lexer);
+  return value;
+}
+
 /*
  * range or set
  * range := CARET
- *        | LITERAL
+ *        | any_single_character
  *        | BACK_SLASH any_single_character
- *        | LITERAL DASH LITERAL
+ *        | any_single_character DASH any_single_character
  *        | range
+ *
+ * inside brackets, `?`, `*`, `{` and the like are plain chars
  */
 static Ast *parse_range(Parser *parser) {
   /* parse negate ^ */
@@ -171,28 +248,28 @@ static Ast *parse_range(Parser *parser) {
     eat(parser, CARET);
   }
 
-  Vector_char *set = new_vector_char();
+  CharSet *set = new_charset_in(parser->arena);
   while (parser->current_token->type != RBRACKET) {
-    if (parser->current_token->type == BACK_SLASH) {
-      push_vector_char(set, eat_escape_char(parser));
-    } else {
-      char from = parser->current_token->value;
-      eat(parser, LITERAL);
-      Ast *right;
-      /* range */
-      if (parser->current_token->type == DASH) {
-        eat(parser, DASH);
-        char to = parser->current_token->value;
-        eat(parser, LITERAL);
-        for (char c = from; c <= to; ++c)
-          push_vector_char(set, c);
+    char from = eat_range_char(parser);
+    /* range */
+    if (parser->current_token->type == DASH) {
+      eat(parser, DASH);
+      if (parser->current_token->type == RBRACKET) {
+        /* a trailing dash is a char */
+        add_char(set, from);
+        add_char(set, '-');
+      } else {
+        add_range(set, from, eat_range_char(parser));
       }
-      /* set */
-      else
-        push_vector_char(set, from);
     }
+    /* set */
+    else
+      add_char(set, from);
   }
-  return new_ast_set(set, is_neg);
+  /* fold the negation into the set */
+  if (is_neg)
+    negate_charset(set);
+  return new_ast_set(parser->arena, set);
 }
 
 /* Entry point for parsing */
@@ -202,5 +279,10 @@ Ast *parse(Parser *parser) {
     printf("unexpected trailing token: %d\n", parser->current_token->type);
     exit(1);
   }
+  if (count_positions(node, MAX_POSITIONS) > MAX_POSITIONS) {
+    printf("pattern longer than %d chars once counts are expanded\n",
+           MAX_POSITIONS);
+    exit(1);
+  }
   return node;
 }
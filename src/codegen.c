@@ -0,0 +1,184 @@
+#include "serialize.c"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * C code generation: a minimized DFA is written as C source for a scanner
+ * that needs nothing from this library, no NFA and no malloc. its function
+ *
+ *   int <prefix>_scan(const char *input, unsigned long len,
+ *                     unsigned long *start, unsigned long *length);
+ *
+ * finds the first longest match in input[0, len) like `dfa_match_span`: it
+ * assigns the span of the match and returns the index of the pattern
+ * matched, or returns -1 with *start = len and *length = 0.
+ */
+
+typedef enum CodeStyle {
+  CODE_TABLES, /* const transition tables and a loop, like flex */
+  CODE_DIRECT, /* one label per state and `goto`s, like re2c or flex -f */
+} CodeStyle;
+
+/* print an array of numbers, `per_line` on each line */
+static void print_array(FILE *out, char *type, char *prefix, char *name,
+                        long *values, size_t len, int per_line) {
+  fprintf(out, "static const %s %s_%s[%zu] = {", type, prefix, name, len);
+  for (size_t i = 0; i < len; ++i) {
+    if (i % per_line == 0)
+      fprintf(out, "\n   ");
+    fprintf(out, " %ld,", values[i]);
+  }
+  fprintf(out, "\n};\n\n");
+}
+
+/* the byte classes and first chars, used by both styles */
+static void print_common_tables(DFA *dfa, char *prefix, FILE *out) {
+  long values[ALPHABET_SIZE];
+  for (int c = 0; c < ALPHABET_SIZE; ++c)
+    values[c] = dfa->classes[c];
+  print_array(out, "unsigned char", prefix, "classes", values, ALPHABET_SIZE,
+              16);
+  for (int c = 0; c < ALPHABET_SIZE; ++c)
+    values[c] = have_char(&dfa->prefilter.set, (char)c) ? 1 : 0;
+  print_array(out, "unsigned char", prefix, "first", values, ALPHABET_SIZE,
+              16);
+}
+
+static void print_tables_scanner(DFA *dfa, char *prefix, FILE *out) {
+  size_t transitions_count = (size_t)dfa->states_count * dfa->classes_count;
+  long *values = (long *)malloc((transitions_count + 1) * sizeof(long));
+  for (size_t i = 0; i < transitions_count; ++i)
+    values[i] = dfa->transitions[i];
+  print_array(out, "unsigned int", prefix, "transitions", values,
+              transitions_count, dfa->classes_count < 16 ? dfa->classes_count
+                                                          : 16);
+  for (DState s = 0; s < dfa->states_count; ++s)
+    values[s] = dfa->accepts[s];
+  print_array(out, "int", prefix, "accepts", values, dfa->states_count, 16);
+  free(values);
+
+  fprintf(out,
+          "int %s_scan(const char *input, unsigned long len,\n"
+          "            unsigned long *start, unsigned long *length) {\n"
+          "  for (unsigned long from = 0; from < len; ++from) {\n"
+          "    if (!%s_first[(unsigned char)input[from]])\n"
+          "      continue;\n"
+          "    unsigned int s = %u;\n"
+          "    int pattern = -1;\n"
+          "    unsigned long end = from;\n"
+          "    for (unsigned long i = from; i < len; ++i) {\n"
+          "      s = %s_transitions[s * %u + "
+          "%s_classes[(unsigned char)input[i]]];\n"
+          "      if (s == %d)\n"
+          "        break;\n"
+          "      if (%s_accepts[s] >= 0) {\n"
+          "        pattern = %s_accepts[s];\n"
+          "        end = i + 1;\n"
+          "      }\n"
+          "    }\n"
+          "    if (pattern >= 0) {\n"
+          "      *start = from;\n"
+          "      *length = end - from;\n"
+          "      return pattern;\n"
+          "    }\n"
+          "  }\n"
+          "  *start = len;\n"
+          "  *length = 0;\n"
+          "  return -1;\n"
+          "}\n",
+          prefix, prefix, dfa->start, prefix, dfa->classes_count, prefix,
+          DFA_DEAD, prefix, prefix);
+}
+
+/*
+ * each state has a label `sN` entered by a transition, which records the
+ * pattern it accepts. a search enters the start state after it, at
+ * `start`, since empty matches don't count.
+ */
+static void print_direct_scanner(DFA *dfa, char *prefix, FILE *out) {
+  unsigned int k = dfa->classes_count;
+  bool *printed = (bool *)malloc(k * sizeof(bool));
+  /* labels nothing jumps to are left out, so the output builds warning-free */
+  bool *targeted = (bool *)calloc(dfa->states_count, sizeof(bool));
+  for (size_t i = 0; i < (size_t)dfa->states_count * k; ++i)
+    targeted[dfa->transitions[i]] = true;
+
+  fprintf(out,
+          "int %s_scan(const char *input, unsigned long len,\n"
+          "            unsigned long *start, unsigned long *length) {\n"
+          "  for (unsigned long from = 0; from < len; ++from) {\n"
+          "    if (!%s_first[(unsigned char)input[from]])\n"
+          "      continue;\n"
+          "    unsigned long i = from;\n"
+          "    int pattern = -1;\n"
+          "    unsigned long end = from;\n"
+          "    goto start;\n",
+          prefix, prefix);
+
+  for (DState s = 0; s < dfa->states_count; ++s) {
+    if (s == DFA_DEAD)
+      continue;
+    if (targeted[s])
+      fprintf(out, "  s%u:\n", s);
+    if (targeted[s] && dfa->accepts[s] >= 0)
+      fprintf(out, "    pattern = %d;\n    end = i;\n", dfa->accepts[s]);
+    if (s == dfa->start)
+      fprintf(out, "  start:\n");
+    fprintf(out, "    if (i == len)\n      goto done;\n");
+    fprintf(out, "    switch (%s_classes[(unsigned char)input[i++]]) {\n",
+            prefix);
+    /* classes going to the same state share a `goto` */
+    for (unsigned int c = 0; c < k; ++c)
+      printed[c] = false;
+    for (unsigned int c = 0; c < k; ++c) {
+      DState target = dfa->transitions[(size_t)s * k + c];
+      if (printed[c] || target == DFA_DEAD)
+        continue;
+      for (unsigned int d = c; d < k; ++d)
+        if (dfa->transitions[(size_t)s * k + d] == target) {
+          fprintf(out, "    case %u:\n", d);
+          printed[d] = true;
+        }
+      fprintf(out, "      goto s%u;\n", target);
+    }
+    fprintf(out, "    default:\n      goto done;\n    }\n");
+  }
+
+  fprintf(out, "  done:\n"
+               "    if (pattern >= 0) {\n"
+               "      *start = from;\n"
+               "      *length = end - from;\n"
+               "      return pattern;\n"
+               "    }\n"
+               "  }\n"
+               "  *start = len;\n"
+               "  *length = 0;\n"
+               "  return -1;\n"
+               "}\n");
+  free(printed);
+  free(targeted);
+}
+
+/* write the C source of a scanner for a DFA, see the top of this file */
+void generate_c(DFA *dfa, char *prefix, CodeStyle style, FILE *out) {
+  fprintf(out, "/* generated by re, %u states, %u byte classes */\n\n",
+          dfa->states_count, dfa->classes_count);
+  print_common_tables(dfa, prefix, out);
+  if (style == CODE_TABLES)
+    print_tables_scanner(dfa, prefix, out);
+  else
+    print_direct_scanner(dfa, prefix, out);
+}
+
+/* write the C source of a scanner for patterns, see `build_many` */
+void generate_scanner(char **patterns, size_t len, char *prefix,
+                      CodeStyle style, FILE *out) {
+  NFA *nfa = build_many(patterns, len);
+  DFA *dfa = nfa2dfa(nfa);
+  dfa_minimize(dfa);
+  generate_c(dfa, prefix, style, out);
+  free_dfa(dfa);
+  free_nfa(nfa);
+}
@@ -1 +1,566 @@
 #include "builder.c"
+#include "util/yy.c"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned long IdxType;
+
+/* a match in the input, without copying it */
+typedef struct Span {
+  IdxType start;
+  IdxType len;
+  int pattern; /* index of the pattern matched, -1 if nothing matches */
+} Span;
+
+/* copy the text of a span of input to (char *)text, return its length */
+static IdxType copy_span(char *input, Span span, char *text) {
+  memcpy(text, input + span.start, span.len);
+  text[span.len] = '\0';
+  return span.len;
+}
+
+/*
+ * scanning g_buffer: the `*_yy_match_span` functions return the span of the
+ * next token, with `start` from g_buffer, and move g_buffer_ptr past it.
+ * `*_yy_match` functions also copy the token to yytext, which grows with the
+ * longest token, see `yy_take`.
+ */
+
+static char *g_yytext_buffer = NULL;
+static IdxType g_yytext_capacity = 0;
+
+/* length of the buffer not scanned yet */
+static IdxType yy_remaining() { return g_buffer + g_buflen - g_buffer_ptr; }
+
+/* make a span found from g_buffer_ptr start from g_buffer, and skip it */
+static Span yy_advance(Span span) {
+  span.start += g_buffer_ptr - g_buffer;
+  g_buffer_ptr = g_buffer + span.start + span.len;
+  return span;
+}
+
+/* copy the text of a span to yytext and yyleng, return its pattern */
+static int yy_take(Span span) {
+  if (span.len + 1 > g_yytext_capacity) {
+    g_yytext_capacity = (span.len + 1) * 2;
+    g_yytext_buffer = (char *)realloc(g_yytext_buffer, g_yytext_capacity);
+  }
+  yytext = g_yytext_buffer;
+  yyleng = copy_span(g_buffer, span, yytext);
+  return span.pattern;
+}
+
+#define ALPHABET_SIZE 256
+#define DFA_DEAD 0 /* the state of the empty NFA state set */
+
+typedef unsigned int DState;
+
+typedef struct DFA {
+  DState states_count;
+  DState start;
+  unsigned char classes[ALPHABET_SIZE]; /* byte class of each char */
+  unsigned int classes_count;
+  DState *transitions; /* classes_count next states for each state */
+  int *accepts;        /* index of the accepted pattern, -1 if none */
+  Prefilter prefilter; /* same as the one of the NFA */
+  /* the file mapped by `load_dfa` holding the tables, NULL if allocated */
+  void *mapping;
+  size_t mapping_len;
+} DFA;
+
+/* create an empty DFA */
+static DFA *new_dfa() {
+  DFA *dfa = (DFA *)malloc(sizeof(DFA));
+  dfa->states_count = 0;
+  dfa->start = DFA_DEAD;
+  dfa->classes_count = 0;
+  dfa->transitions = NULL;
+  dfa->accepts = NULL;
+  dfa->prefilter.count = 256;
+  dfa->mapping = NULL;
+  dfa->mapping_len = 0;
+  return dfa;
+}
+
+static void unmap_dfa(DFA *dfa);
+
+/* free a DFA */
+void free_dfa(DFA *dfa) {
+  if (dfa->mapping != NULL) {
+    unmap_dfa(dfa);
+  } else {
+    free(dfa->transitions);
+    free(dfa->accepts);
+  }
+  free(dfa);
+}
+
+/* the next state of `state` with input `c` */
+static inline DState dfa_next(DFA *dfa, DState state, char c) {
+  return dfa->transitions[(size_t)state * dfa->classes_count +
+                          dfa->classes[(unsigned char)c]];
+}
+
+/*
+ * byte classes: chars that no label of the NFA tells apart share a class, so
+ * transitions are stored per class instead of per char
+ */
+
+/* map every char to its class, return the number of classes */
+unsigned int byte_classes(NFA *nfa, unsigned char classes[ALPHABET_SIZE]) {
+  unsigned int count = 1;
+  memset(classes, 0, ALPHABET_SIZE);
+
+  int split[ALPHABET_SIZE * 2];
+  unsigned char refined[ALPHABET_SIZE];
+  for (size_t i = 0; i < nfa->edges_count; ++i) {
+    Label *label = nfa->edges[i]->label;
+    if (is_epsilon(label))
+      continue;
+
+    /* split every class into the chars the label accepts and the others */
+    for (unsigned int k = 0; k < count * 2; ++k)
+      split[k] = -1;
+    count = 0;
+    for (int c = 0; c < ALPHABET_SIZE; ++c) {
+      int key = classes[c] * 2 + accept(label, (char)c);
+      if (split[key] < 0)
+        split[key] = count++;
+      refined[c] = split[key];
+    }
+    memcpy(classes, refined, ALPHABET_SIZE);
+  }
+  return count;
+}
+
+/* the first char of each class */
+static void class_representatives(unsigned char classes[ALPHABET_SIZE],
+                                  char representatives[ALPHABET_SIZE]) {
+  for (int c = ALPHABET_SIZE - 1; c >= 0; --c)
+    representatives[classes[c]] = (char)c;
+}
+
+/*
+ * subset construction
+ */
+
+/* a sorted set of NFA states, named by a DFA state */
+typedef struct StateSet {
+  State *states;
+  size_t len;
+  size_t hash;
+} StateSet;
+
+typedef struct SubsetTable {
+  StateSet *sets; /* indexed by DFA state */
+  DState len;
+  DState capacity;
+  DState *buckets; /* DFA state + 1, or 0 for an empty bucket */
+  size_t buckets_count;
+} SubsetTable;
+
+static SubsetTable *new_subset_table() {
+  SubsetTable *table = (SubsetTable *)malloc(sizeof(SubsetTable));
+  table->len = 0;
+  table->capacity = 16;
+  table->sets = (StateSet *)malloc(table->capacity * sizeof(StateSet));
+  table->buckets_count = 32;
+  table->buckets = (DState *)calloc(table->buckets_count, sizeof(DState));
+  return table;
+}
+
+static void free_subset_table(SubsetTable *table) {
+  for (DState i = 0; i < table->len; ++i)
+    free(table->sets[i].states);
+  free(table->sets);
+  free(table->buckets);
+  free(table);
+}
+
+/* FNV-1a over the sorted states */
+static size_t hash_states(State *states, size_t len) {
+  size_t hash = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= states[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/* double the buckets and insert all known sets again */
+static void grow_buckets(SubsetTable *table) {
+  free(table->buckets);
+  table->buckets_count *= 2;
+  table->buckets = (DState *)calloc(table->buckets_count, sizeof(DState));
+  size_t mask = table->buckets_count - 1;
+  for (DState i = 0; i < table->len; ++i) {
+    size_t b = table->sets[i].hash & mask;
+    while (table->buckets[b] != 0)
+      b = (b + 1) & mask;
+    table->buckets[b] = i + 1;
+  }
+}
+
+/*
+ * return the DFA state named by the states of `s`, creating one if the set is
+ * new. `s` is sorted in place.
+ */
+static DState intern_states(SubsetTable *table, States *s) {
+  sort_states(s);
+  size_t hash = hash_states(s->states, s->len);
+  size_t mask = table->buckets_count - 1;
+  size_t b = hash & mask;
+  while (table->buckets[b] != 0) {
+    StateSet *set = &table->sets[table->buckets[b] - 1];
+    if (set->hash == hash && set->len == s->len &&
+        memcmp(set->states, s->states, s->len * sizeof(State)) == 0)
+      return table->buckets[b] - 1;
+    b = (b + 1) & mask;
+  }
+
+  if (table->len == table->capacity) {
+    table->capacity *= 2;
+    table->sets =
+        (StateSet *)realloc(table->sets, table->capacity * sizeof(StateSet));
+  }
+  StateSet *set = &table->sets[table->len];
+  set->len = s->len;
+  set->hash = hash;
+  set->states = (State *)malloc((s->len + 1) * sizeof(State));
+  memcpy(set->states, s->states, s->len * sizeof(State));
+  table->buckets[b] = table->len + 1;
+  DState state = table->len++;
+
+  if (table->len * 2 > table->buckets_count)
+    grow_buckets(table);
+  return state;
+}
+
+/* replace the states of a container with a state set */
+static void load_states(States *s, StateSet *set) {
+  clear_states(s);
+  for (size_t i = 0; i < set->len; ++i)
+    push_state(s, set->states[i]);
+}
+
+/* the index of the first pattern whose target state is in the set, or -1 */
+static int accepted_pattern(NFA *nfa, StateSet *set) {
+  for (size_t i = 0; i < nfa->target_states->len; ++i) {
+    State target = nfa->target_states->states[i];
+    if (bsearch(&target, set->states, set->len, sizeof(State), compare_states))
+      return target_pattern(nfa, i);
+  }
+  return -1;
+}
+
+/* convert an NFA to a DFA with subset construction */
+DFA *nfa2dfa(NFA *nfa) {
+  DFA *dfa = new_dfa();
+  SubsetTable *table = new_subset_table();
+  dfa->classes_count = byte_classes(nfa, dfa->classes);
+  char representatives[ALPHABET_SIZE];
+  class_representatives(dfa->classes, representatives);
+  unsigned int k = dfa->classes_count;
+
+  /* the states of the row being filled, and of one of its targets */
+  States *s = new_states_with_capacity(nfa->states_count);
+  States *next = new_states_with_capacity(nfa->states_count);
+
+  /* the empty set is the dead state */
+  intern_states(table, s);
+
+  push_state(s, 0);
+  close_states(nfa, s);
+  dfa->start = intern_states(table, s);
+  dfa->prefilter = nfa->prefilter;
+
+  /* sets found while filling a row are appended, and filled later */
+  DState capacity = 0;
+  for (DState d = 0; d < table->len; ++d) {
+    if (d == capacity) {
+      capacity = capacity ? capacity * 2 : 16;
+      dfa->transitions = (DState *)realloc(
+          dfa->transitions, (size_t)capacity * k * sizeof(DState));
+      dfa->accepts = (int *)realloc(dfa->accepts, capacity * sizeof(int));
+    }
+
+    dfa->accepts[d] = accepted_pattern(nfa, &table->sets[d]);
+    load_states(s, &table->sets[d]);
+    for (unsigned int c = 0; c < k; ++c) {
+      move_states(nfa, s, representatives[c], next);
+      close_states(nfa, next);
+      dfa->transitions[(size_t)d * k + c] = intern_states(table, next);
+    }
+  }
+  dfa->states_count = table->len;
+  free_states(s);
+  free_states(next);
+
+  free_subset_table(table);
+  return dfa;
+}
+
+/*
+ * minimization
+ */
+
+typedef struct MinimizeReport {
+  DState states_before;
+  DState states_after;
+} MinimizeReport;
+
+/* blocks of states, each block is a contiguous range of `elems` */
+typedef struct Partition {
+  DState *elems;
+  DState *loc;      /* index of each state in `elems` */
+  DState *block_of; /* block of each state */
+  DState *first;    /* first index of each block in `elems` */
+  DState *end;      /* one past the last index of each block */
+  DState *marked;   /* marked states of each block, at its beginning */
+  bool *in_worklist;
+  DState *worklist;
+  DState worklist_len;
+  DState blocks_count;
+} Partition;
+
+static void push_worklist(Partition *p, DState block) {
+  p->in_worklist[block] = true;
+  p->worklist[p->worklist_len++] = block;
+}
+
+/* move a state to the marked part of its block */
+static void mark_state(Partition *p, DState state, DState *touched,
+                       DState *touched_len) {
+  DState b = p->block_of[state];
+  DState i = p->loc[state];
+  DState j = p->first[b] + p->marked[b];
+  if (i >= j) {
+    DState other = p->elems[j];
+    p->elems[j] = state;
+    p->loc[state] = j;
+    p->elems[i] = other;
+    p->loc[other] = i;
+    if (p->marked[b]++ == 0)
+      touched[(*touched_len)++] = b;
+  }
+}
+
+/* split the marked states of every touched block into new blocks */
+static void split_blocks(Partition *p, DState *touched, DState touched_len) {
+  for (DState t = 0; t < touched_len; ++t) {
+    DState b = touched[t];
+    DState marked = p->marked[b];
+    p->marked[b] = 0;
+    if (marked == p->end[b] - p->first[b])
+      continue;
+
+    DState nb = p->blocks_count++;
+    p->first[nb] = p->first[b];
+    p->end[nb] = p->first[b] + marked;
+    p->marked[nb] = 0;
+    p->in_worklist[nb] = false;
+    p->first[b] = p->end[nb];
+    for (DState i = p->first[nb]; i < p->end[nb]; ++i)
+      p->block_of[p->elems[i]] = nb;
+
+    if (p->in_worklist[b] ||
+        p->end[nb] - p->first[nb] <= p->end[b] - p->first[b])
+      push_worklist(p, nb);
+    else
+      push_worklist(p, b);
+  }
+}
+
+/*
+ * merge equivalent states with Hopcroft's algorithm. states accepting
+ * different patterns are never merged, and the dead state stays apart from
+ * other non-accepting states so that matchers still restart on it.
+ */
+MinimizeReport dfa_minimize(DFA *dfa) {
+  DState n = dfa->states_count;
+  unsigned int k = dfa->classes_count;
+  DState *delta = dfa->transitions;
+  MinimizeReport report = {n, n};
+  /* the tables of a loaded DFA are read-only, and already minimized */
+  if (dfa->mapping != NULL)
+    return report;
+
+  Partition p;
+  p.elems = (DState *)malloc(n * sizeof(DState));
+  p.loc = (DState *)malloc(n * sizeof(DState));
+  p.block_of = (DState *)malloc(n * sizeof(DState));
+  p.first = (DState *)malloc(n * sizeof(DState));
+  p.end = (DState *)malloc(n * sizeof(DState));
+  p.marked = (DState *)calloc(n, sizeof(DState));
+  p.in_worklist = (bool *)calloc(n, sizeof(bool));
+  p.worklist = (DState *)malloc(n * sizeof(DState));
+  p.worklist_len = 0;
+
+  /* initial blocks: the dead state, then one block per accepted pattern */
+  int max_pattern = -1;
+  for (DState s = 0; s < n; ++s)
+    if (dfa->accepts[s] > max_pattern)
+      max_pattern = dfa->accepts[s];
+  DState keys = max_pattern + 3; /* dead, not accepting, patterns */
+  DState *sizes = (DState *)calloc(keys, sizeof(DState));
+  DState *key_block = (DState *)malloc(keys * sizeof(DState));
+  DState *key_of = (DState *)malloc(n * sizeof(DState));
+  for (DState s = 0; s < n; ++s) {
+    key_of[s] = s == DFA_DEAD ? 0 : dfa->accepts[s] + 2;
+    ++sizes[key_of[s]];
+  }
+  p.blocks_count = 0;
+  DState offset = 0;
+  for (DState k = 0; k < keys; ++k) {
+    if (sizes[k] == 0)
+      continue;
+    DState b = p.blocks_count++;
+    key_block[k] = b;
+    p.first[b] = p.end[b] = offset;
+    offset += sizes[k];
+    push_worklist(&p, b);
+  }
+  for (DState s = 0; s < n; ++s) {
+    DState b = key_block[key_of[s]];
+    p.block_of[s] = b;
+    p.loc[s] = p.end[b];
+    p.elems[p.end[b]++] = s;
+  }
+  free(sizes);
+  free(key_block);
+  free(key_of);
+
+  /* inverse transitions, grouped by (class, target) */
+  size_t pairs = (size_t)n * k;
+  DState *inverse_offsets = (DState *)calloc(pairs + 1, sizeof(DState));
+  DState *inverse = (DState *)malloc(pairs * sizeof(DState));
+  for (DState s = 0; s < n; ++s)
+    for (unsigned int c = 0; c < k; ++c)
+      ++inverse_offsets[(size_t)c * n + delta[(size_t)s * k + c] + 1];
+  for (size_t i = 0; i < pairs; ++i)
+    inverse_offsets[i + 1] += inverse_offsets[i];
+  DState *fill = (DState *)malloc(pairs * sizeof(DState));
+  memcpy(fill, inverse_offsets, pairs * sizeof(DState));
+  for (DState s = 0; s < n; ++s)
+    for (unsigned int c = 0; c < k; ++c)
+      inverse[fill[(size_t)c * n + delta[(size_t)s * k + c]]++] = s;
+  free(fill);
+
+  /* refine until no block can split another */
+  DState *splitter = (DState *)malloc(n * sizeof(DState));
+  DState *touched = (DState *)malloc(n * sizeof(DState));
+  while (p.worklist_len > 0) {
+    DState a = p.worklist[--p.worklist_len];
+    p.in_worklist[a] = false;
+    DState splitter_len = p.end[a] - p.first[a];
+    memcpy(splitter, p.elems + p.first[a], splitter_len * sizeof(DState));
+
+    for (unsigned int c = 0; c < k; ++c) {
+      DState touched_len = 0;
+      for (DState i = 0; i < splitter_len; ++i) {
+        size_t pair = (size_t)c * n + splitter[i];
+        for (DState j = inverse_offsets[pair]; j < inverse_offsets[pair + 1];
+             ++j)
+          mark_state(&p, inverse[j], touched, &touched_len);
+      }
+      split_blocks(&p, touched, touched_len);
+    }
+  }
+  free(splitter);
+  free(touched);
+  free(inverse_offsets);
+  free(inverse);
+
+  /* one state per block, the dead state keeps block 0 */
+  DState m = p.blocks_count;
+  DState *transitions = (DState *)malloc((size_t)m * k * sizeof(DState));
+  int *accepts = (int *)malloc(m * sizeof(int));
+  for (DState b = 0; b < m; ++b) {
+    DState representative = p.elems[p.first[b]];
+    accepts[b] = dfa->accepts[representative];
+    for (unsigned int c = 0; c < k; ++c)
+      transitions[(size_t)b * k + c] =
+          p.block_of[delta[(size_t)representative * k + c]];
+  }
+  dfa->start = p.block_of[dfa->start];
+  free(dfa->transitions);
+  free(dfa->accepts);
+  dfa->transitions = transitions;
+  dfa->accepts = accepts;
+  dfa->states_count = m;
+  report.states_after = m;
+
+  free(p.elems);
+  free(p.loc);
+  free(p.block_of);
+  free(p.first);
+  free(p.end);
+  free(p.marked);
+  free(p.in_worklist);
+  free(p.worklist);
+  return report;
+}
+
+/*
+ * matching, same as the functions in match.c but with one lookup per char
+ */
+
+/* if the input string fully matches the pattern */
+bool dfa_match_full(DFA *dfa, char *input) {
+  DState s = dfa->start;
+  for (char *next_char = input; *next_char != '\0'; ++next_char)
+    s = dfa_next(dfa, s, *next_char);
+  return dfa->accepts[s] >= 0;
+}
+
+/* same as `dfa_match_span`, see `match_span_with` for `starts`, `hit_end` */
+static Span dfa_find(DFA *dfa, char *input, IdxType len, IdxType starts,
+                     bool *hit_end) {
+  Span span = {len, 0, -1};
+  *hit_end = false;
+  for (IdxType start = 0; start < starts; ++start) {
+    start = prefilter_skip(&dfa->prefilter, input, start, starts);
+    if (start == starts)
+      break;
+    DState s = dfa->start;
+    for (IdxType i = start; i < len; ++i) {
+      s = dfa_next(dfa, s, input[i]);
+      if (s == DFA_DEAD)
+        break;
+      if (dfa->accepts[s] >= 0)
+        span = (Span){start, i + 1 - start, dfa->accepts[s]};
+    }
+    if (s != DFA_DEAD)
+      *hit_end = true;
+    if (span.pattern >= 0)
+      break;
+  }
+  return span;
+}
+
+/* find the first longest match in input[0, len), see `match_span` */
+Span dfa_match_span(DFA *dfa, char *input, IdxType len) {
+  bool hit_end;
+  return dfa_find(dfa, input, len, len, &hit_end);
+}
+
+/*
+ * find the first longest match, and copy it to (char *)text, return its length
+ */
+IdxType dfa_match(DFA *dfa, char *input, char *text) {
+  return copy_span(input, dfa_match_span(dfa, input, strlen(input)), text);
+}
+
+/* find the next token from g_buffer_ptr without copying it, see `yy_take` */
+Span dfa_yy_match_span(DFA *dfa) {
+  return yy_advance(dfa_match_span(dfa, g_buffer_ptr, yy_remaining()));
+}
+
+/*
+ * similar to `dfa_match`, but copy to yytext, assign its length to yyleng,
+ * and return the index of the pattern matched
+ */
+int dfa_yy_match(DFA *dfa) { return yy_take(dfa_yy_match_span(dfa)); }
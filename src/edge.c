@@ -1,32 +1,31 @@
 #include "state.c"
 #include <stdbool.h>
 
-#define TYPE char
-#include "util/vector.c"
+#include "util/charset.c"
 
 typedef struct Label {
   enum {
     CHAR,
     SET,
-    NEG_SET,
   } type;
 
   union {
     char symbol;
-    Vector_char *set;
+    CharSet *set;
   } data;
 } Label;
 
-Label *new_literal_label(char symbol) {
-  Label *label = (Label *)malloc(sizeof(Label));
+/* labels and edges are allocated from the arena of their NFA */
+Label *new_literal_label(Arena *arena, char symbol) {
+  Label *label = (Label *)arena_alloc(arena, sizeof(Label));
   label->type = CHAR;
   label->data.symbol = symbol;
   return label;
 }
 
-Label *new_set_label(Vector_char *set, bool is_neg) {
-  Label *label = (Label *)malloc(sizeof(Label));
-  label->type = (is_neg ? NEG_SET : SET);
+Label *new_set_label(Arena *arena, CharSet *set) {
+  Label *label = (Label *)arena_alloc(arena, sizeof(Label));
+  label->type = SET;
   label->data.set = set;
   return label;
 }
@@ -38,8 +37,8 @@ typedef struct Edge {
 } Edge;
 
 /* create a new edge */
-Edge *new_edge(Label *label, State from, State to) {
-  Edge *e = (Edge *)malloc(sizeof(Edge));
+Edge *new_edge(Arena *arena, Label *label, State from, State to) {
+  Edge *e = (Edge *)arena_alloc(arena, sizeof(Edge));
   e->label = label;
   e->from = from;
   e->to = to;
@@ -0,0 +1,100 @@
+#include "parallel.c"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FILE_STREAM_BUFFER_SIZE (1 << 16)
+
+/* a file read as a stream, and the errno of a failed read or 0 */
+typedef struct FileStream {
+  int fd;
+  int error;
+} FileStream;
+
+static IdxType read_file_stream(char *buffer, IdxType max, void *data) {
+  FileStream *stream = (FileStream *)data;
+  ssize_t n;
+  do
+    n = read(stream->fd, buffer, max);
+  while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    stream->error = errno;
+    return 0;
+  }
+  return n;
+}
+
+/* scan what can't be mapped, like pipes, devices and files of /proc */
+static int scan_file_stream(int fd, Automaton *automaton,
+                            TokenCallback callback, void *data) {
+  FileStream stream = {fd, 0};
+  Scanner *scanner = new_scanner(automaton);
+  scanner_set_input(scanner, read_file_stream, &stream,
+                    FILE_STREAM_BUFFER_SIZE);
+  while (!scanner_is_done(scanner)) {
+    Span span = scanner_match_span(scanner);
+    if (span.pattern < 0)
+      break;
+    span.start -= scanner->offset;
+    callback(scanner->buffer, span, data);
+  }
+  free_scanner(scanner);
+  if (stream.error != 0) {
+    errno = stream.error;
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * scan a file mapped read-only, so tokens are spans of the page cache and
+ * the file is never copied. return 0, or -1 if the file can't be read, with
+ * errno set.
+ *
+ * a file which is not regular, or says it is empty like the files of /proc,
+ * is read as a stream instead: each token is then a span of the scanner's
+ * buffer, which is only valid during the callback.
+ */
+int scan_file(char *path, Automaton *automaton, TokenCallback callback,
+              void *data) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return -1;
+  }
+  if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+    int result = scan_file_stream(fd, automaton, callback, data);
+    int error = errno;
+    close(fd);
+    errno = error;
+    return result;
+  }
+
+  IdxType len = st.st_size;
+  char *buffer = (char *)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (buffer == MAP_FAILED) {
+    close(fd);
+    return -1;
+  }
+  madvise(buffer, len, MADV_SEQUENTIAL);
+  close(fd);
+
+  Scanner *scanner = new_scanner(automaton);
+  scanner_set_buffer(scanner, buffer, len);
+  while (!scanner_is_done(scanner)) {
+    Span span = scanner_match_span(scanner);
+    if (span.pattern < 0)
+      break;
+    callback(buffer, span, data);
+  }
+  free_scanner(scanner);
+
+  munmap(buffer, len);
+  return 0;
+}
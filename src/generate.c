@@ -0,0 +1,20 @@
+#include "match.c"
+#include <stdio.h>
+#include <string.h>
+
+/* write a scanner for patterns to stdout, see codegen.c */
+int main(int argc, char *argv[]) {
+  CodeStyle style = CODE_DIRECT;
+  int i = 1;
+  if (i < argc && strcmp(argv[i], "-t") == 0) {
+    style = CODE_TABLES;
+    ++i;
+  }
+  if (argc - i < 2) {
+    fprintf(stderr, "usage: %s [-t] prefix pattern...\n", argv[0]);
+    return 1;
+  }
+  char *prefix = argv[i];
+  generate_scanner(argv + i + 1, argc - i - 1, prefix, style, stdout);
+  return 0;
+}
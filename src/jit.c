@@ -0,0 +1,233 @@
+#include "codegen.c"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/*
+ * JIT: a DFA is compiled to x86-64 code, one block per state. a block
+ * records the pattern its state accepts and where the match ends, reads a
+ * char, and jumps to the next block by comparing the char with the ranges
+ * of chars going to each state. the dead state is the exit. elsewhere, or
+ * when the code can't be mapped executable, the table interpreter is used.
+ *
+ * the compiled function matches from the start of the input:
+ *   int fn(const char *input, const char *end, const char **match_end);
+ * returns the pattern of the longest match and its end, or -1.
+ */
+
+typedef int (*JitFunction)(const char *input, const char *end,
+                           const char **match_end);
+
+typedef struct JitDFA {
+  DFA *dfa;
+  JitFunction function; /* NULL to use the table interpreter */
+  void *code;
+  size_t code_len;
+} JitDFA;
+
+#if defined(__x86_64__) && defined(__linux__)
+
+/* machine code being written, with jumps to patch once blocks are placed */
+typedef struct Assembler {
+  unsigned char *bytes;
+  size_t len;
+  size_t capacity;
+  size_t *patches; /* offsets of rel32 fields, to the block in `targets` */
+  size_t *targets;
+  size_t patches_len;
+  size_t patches_capacity;
+} Assembler;
+
+static void emit(Assembler *a, const void *bytes, size_t len) {
+  if (a->len + len > a->capacity) {
+    a->capacity = (a->len + len) * 2;
+    a->bytes = (unsigned char *)realloc(a->bytes, a->capacity);
+  }
+  memcpy(a->bytes + a->len, bytes, len);
+  a->len += len;
+}
+
+static void emit_u32(Assembler *a, uint32_t value) {
+  emit(a, &value, sizeof(value));
+}
+
+/* emit a jump opcode with a rel32 to the block `target`, patched later */
+static void emit_jump(Assembler *a, const void *opcode, size_t len,
+                      size_t target) {
+  emit(a, opcode, len);
+  if (a->patches_len == a->patches_capacity) {
+    a->patches_capacity = a->patches_capacity * 2 + 64;
+    a->patches =
+        (size_t *)realloc(a->patches, a->patches_capacity * sizeof(size_t));
+    a->targets =
+        (size_t *)realloc(a->targets, a->patches_capacity * sizeof(size_t));
+  }
+  a->patches[a->patches_len] = a->len;
+  a->targets[a->patches_len++] = target;
+  emit_u32(a, 0);
+}
+
+/*
+ * registers: rdi is the next char, rsi the end of the input, rdx where to
+ * store the end of the match, eax the pattern matched, r8 the end of the
+ * match, ecx the char read and r9d a scratch.
+ *
+ * blocks are numbered: 2 * state enters a state with a transition, and
+ * 2 * state + 1 enters it after that, to read the next char. the last block
+ * is the exit.
+ */
+static void assemble(Assembler *a, DFA *dfa, size_t *blocks) {
+  static const unsigned char JMP[] = {0xe9};
+  static const unsigned char JE[] = {0x0f, 0x84};
+  static const unsigned char JBE[] = {0x0f, 0x86};
+  static const unsigned char JAE[] = {0x0f, 0x83};
+  size_t exit_block = 2 * (size_t)dfa->states_count;
+
+  /* mov eax, -1; mov r8, rdi; jmp start */
+  emit(a, "\xb8\xff\xff\xff\xff\x49\x89\xf8", 8);
+  emit_jump(a, JMP, 1, 2 * (size_t)dfa->start + 1);
+
+  for (DState s = 0; s < dfa->states_count; ++s) {
+    if (s == DFA_DEAD)
+      continue;
+    blocks[2 * s] = a->len;
+    if (dfa->accepts[s] >= 0) {
+      /* mov eax, pattern; mov r8, rdi */
+      emit(a, "\xb8", 1);
+      emit_u32(a, (uint32_t)dfa->accepts[s]);
+      emit(a, "\x49\x89\xf8", 3);
+    }
+    blocks[2 * s + 1] = a->len;
+    /* cmp rdi, rsi; jae exit; movzx ecx, byte [rdi]; inc rdi */
+    emit(a, "\x48\x39\xf7", 3);
+    emit_jump(a, JAE, 2, exit_block);
+    emit(a, "\x0f\xb6\x0f\x48\xff\xc7", 6);
+
+    /* one test per range of chars going to the same state */
+    for (int c = 0; c < ALPHABET_SIZE;) {
+      DState target = dfa->transitions[(size_t)s * dfa->classes_count +
+                                       dfa->classes[c]];
+      int to = c;
+      while (to + 1 < ALPHABET_SIZE &&
+             dfa->transitions[(size_t)s * dfa->classes_count +
+                              dfa->classes[to + 1]] == target)
+        ++to;
+      if (target != DFA_DEAD) {
+        if (c == to) {
+          /* cmp ecx, c; je target */
+          emit(a, "\x81\xf9", 2);
+          emit_u32(a, c);
+          emit_jump(a, JE, 2, 2 * (size_t)target);
+        } else {
+          /* lea r9d, [rcx - c]; cmp r9d, to - c; jbe target */
+          emit(a, "\x44\x8d\x89", 3);
+          emit_u32(a, (uint32_t)-c);
+          emit(a, "\x41\x81\xf9", 3);
+          emit_u32(a, to - c);
+          emit_jump(a, JBE, 2, 2 * (size_t)target);
+        }
+      }
+      c = to + 1;
+    }
+    emit_jump(a, JMP, 1, exit_block);
+  }
+
+  /* exit: mov [rdx], r8; ret */
+  blocks[exit_block] = a->len;
+  emit(a, "\x4c\x89\x02\xc3", 4);
+
+  for (size_t i = 0; i < a->patches_len; ++i) {
+    int32_t rel = (int32_t)(blocks[a->targets[i]] - (a->patches[i] + 4));
+    memcpy(a->bytes + a->patches[i], &rel, sizeof(rel));
+  }
+}
+
+/* compile a DFA to an executable mapping, return if it worked */
+static bool jit_compile(JitDFA *jit) {
+  DFA *dfa = jit->dfa;
+  Assembler a = {0};
+  size_t *blocks =
+      (size_t *)calloc(2 * (size_t)dfa->states_count + 1, sizeof(size_t));
+  assemble(&a, dfa, blocks);
+  free(blocks);
+  free(a.patches);
+  free(a.targets);
+
+  void *code = mmap(NULL, a.len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (code == MAP_FAILED) {
+    free(a.bytes);
+    return false;
+  }
+  memcpy(code, a.bytes, a.len);
+  free(a.bytes);
+  /* never writable and executable at once */
+  if (mprotect(code, a.len, PROT_READ | PROT_EXEC) != 0) {
+    munmap(code, a.len);
+    return false;
+  }
+  jit->code = code;
+  jit->code_len = a.len;
+  jit->function = (JitFunction)code;
+  return true;
+}
+
+#else
+
+static bool jit_compile(JitDFA *jit) { return false; }
+
+#endif
+
+/* compile a DFA, which must outlive the result, to native code if possible */
+JitDFA *new_jit_dfa(DFA *dfa) {
+  JitDFA *jit = (JitDFA *)malloc(sizeof(JitDFA));
+  jit->dfa = dfa;
+  jit->function = NULL;
+  jit->code = NULL;
+  jit->code_len = 0;
+  jit_compile(jit);
+  return jit;
+}
+
+void free_jit_dfa(JitDFA *jit) {
+  if (jit->code != NULL)
+    munmap(jit->code, jit->code_len);
+  free(jit);
+}
+
+/* find the first longest match in input[0, len), see `match_span` */
+Span jit_match_span(JitDFA *jit, char *input, IdxType len) {
+  if (jit->function == NULL)
+    return dfa_match_span(jit->dfa, input, len);
+  for (IdxType start = 0; start < len; ++start) {
+    start = prefilter_skip(&jit->dfa->prefilter, input, start, len);
+    if (start == len)
+      break;
+    const char *end;
+    int pattern = jit->function(input + start, input + len, &end);
+    if (pattern >= 0)
+      return (Span){start, end - (input + start), pattern};
+  }
+  return (Span){len, 0, -1};
+}
+
+/*
+ * find the first longest match, and copy it to (char *)text, return its length
+ */
+IdxType jit_match(JitDFA *jit, char *input, char *text) {
+  return copy_span(input, jit_match_span(jit, input, strlen(input)), text);
+}
+
+/* find the next token from g_buffer_ptr without copying it */
+Span jit_yy_match_span(JitDFA *jit) {
+  return yy_advance(jit_match_span(jit, g_buffer_ptr, yy_remaining()));
+}
+
+/*
+ * similar to `jit_match`, but copy to yytext, assign its length to yyleng,
+ * and return the index of the pattern matched
+ */
+int jit_yy_match(JitDFA *jit) { return yy_take(jit_yy_match_span(jit)); }
@@ -0,0 +1,198 @@
+#include "jit.c"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/*
+ * a DFA built while matching: each set of NFA states met is cached as a DFA
+ * state, and its transitions are filled on first use. when the cache grows
+ * past its budget, it is flushed and matching goes on from the current set.
+ */
+
+#define LAZY_UNKNOWN ((DState)-1) /* transition not computed yet */
+
+typedef struct LazyDFA {
+  NFA *nfa;
+  unsigned char classes[ALPHABET_SIZE]; /* byte class of each char */
+  unsigned int classes_count;
+  char representatives[ALPHABET_SIZE]; /* the first char of each class */
+  SubsetTable *table;  /* the NFA states of each cached state */
+  DState *transitions; /* classes_count next states for each cached state */
+  int *accepts;        /* index of the accepted pattern, -1 if none */
+  DState capacity;
+  DState start;
+  States *start_states; /* ε-closure of the NFA start state, sorted */
+  States *from;         /* scratch states to compute a missing transition */
+  States *next;
+  size_t budget;        /* bytes the cache may use */
+  size_t used;
+  /* counters */
+  size_t hits;
+  size_t misses;
+  size_t flushes;
+} LazyDFA;
+
+/* approximate bytes used to cache a state of `len` NFA states */
+static size_t lazy_state_size(LazyDFA *lazy, size_t len) {
+  return lazy->classes_count * sizeof(DState) + sizeof(int) +
+         sizeof(StateSet) + (len + 1) * sizeof(State) + 2 * sizeof(DState);
+}
+
+/* cache the state named by the states of `s`, `s` is sorted in place */
+static DState lazy_add_state(LazyDFA *lazy, States *s) {
+  DState len = lazy->table->len;
+  DState state = intern_states(lazy->table, s);
+  if (lazy->table->len == len)
+    return state;
+
+  if (state == lazy->capacity) {
+    lazy->capacity = lazy->capacity ? lazy->capacity * 2 : 16;
+    lazy->transitions = (DState *)realloc(
+        lazy->transitions,
+        (size_t)lazy->capacity * lazy->classes_count * sizeof(DState));
+    lazy->accepts =
+        (int *)realloc(lazy->accepts, lazy->capacity * sizeof(int));
+  }
+  for (unsigned int c = 0; c < lazy->classes_count; ++c)
+    lazy->transitions[(size_t)state * lazy->classes_count + c] = LAZY_UNKNOWN;
+  lazy->accepts[state] = accepted_pattern(lazy->nfa, &lazy->table->sets[state]);
+  lazy->used += lazy_state_size(lazy, s->len);
+  return state;
+}
+
+/* drop all cached states but the dead and start states */
+static void lazy_reset(LazyDFA *lazy) {
+  if (lazy->table != NULL)
+    free_subset_table(lazy->table);
+  lazy->table = new_subset_table();
+  lazy->used = 0;
+
+  clear_states(lazy->from);
+  lazy_add_state(lazy, lazy->from); /* the dead state */
+  lazy->start = lazy_add_state(lazy, lazy->start_states);
+}
+
+/* create a lazy DFA for an NFA, caching at most `budget` bytes of states */
+LazyDFA *new_lazy_dfa(NFA *nfa, size_t budget) {
+  LazyDFA *lazy = (LazyDFA *)malloc(sizeof(LazyDFA));
+  lazy->nfa = nfa;
+  lazy->classes_count = byte_classes(nfa, lazy->classes);
+  class_representatives(lazy->classes, lazy->representatives);
+  lazy->table = NULL;
+  lazy->transitions = NULL;
+  lazy->accepts = NULL;
+  lazy->capacity = 0;
+  lazy->budget = budget;
+  lazy->hits = 0;
+  lazy->misses = 0;
+  lazy->flushes = 0;
+
+  lazy->from = new_states_with_capacity(nfa->states_count);
+  lazy->next = new_states_with_capacity(nfa->states_count);
+  lazy->start_states = new_states_with_capacity(nfa->states_count);
+  push_state(lazy->start_states, 0);
+  close_states(nfa, lazy->start_states);
+  lazy_reset(lazy);
+  return lazy;
+}
+
+/* free a lazy DFA, the NFA is not freed */
+void free_lazy_dfa(LazyDFA *lazy) {
+  free_subset_table(lazy->table);
+  free(lazy->transitions);
+  free(lazy->accepts);
+  free_states(lazy->start_states);
+  free_states(lazy->from);
+  free_states(lazy->next);
+  free(lazy);
+}
+
+/* the next state of `state` with input `c`, computed on a cache miss */
+static DState lazy_next(LazyDFA *lazy, DState state, char c) {
+  unsigned char k = lazy->classes[(unsigned char)c];
+  size_t slot = (size_t)state * lazy->classes_count + k;
+  DState next_state = lazy->transitions[slot];
+  if (next_state != LAZY_UNKNOWN) {
+    ++(lazy->hits);
+    return next_state;
+  }
+
+  ++(lazy->misses);
+  NFA *nfa = lazy->nfa;
+  States *next = lazy->next;
+  load_states(lazy->from, &lazy->table->sets[state]);
+  move_states(nfa, lazy->from, lazy->representatives[k], next);
+  close_states(nfa, next);
+  next_state = lazy_add_state(lazy, next);
+
+  if (lazy->used > lazy->budget) {
+    /* `state` is gone after flushing, so its transition is not recorded */
+    ++(lazy->flushes);
+    lazy_reset(lazy);
+    next_state = lazy_add_state(lazy, next);
+  } else {
+    lazy->transitions[slot] = next_state;
+  }
+  return next_state;
+}
+
+/*
+ * matching, same as the functions in dfa.c
+ */
+
+/* if the input string fully matches the pattern */
+bool lazy_match_full(LazyDFA *lazy, char *input) {
+  DState s = lazy->start;
+  for (char *next_char = input; *next_char != '\0'; ++next_char)
+    s = lazy_next(lazy, s, *next_char);
+  return lazy->accepts[s] >= 0;
+}
+
+/* same as `lazy_match_span`, see `match_span_with` for `starts`, `hit_end` */
+static Span lazy_find(LazyDFA *lazy, char *input, IdxType len, IdxType starts,
+                      bool *hit_end) {
+  Span span = {len, 0, -1};
+  *hit_end = false;
+  for (IdxType start = 0; start < starts; ++start) {
+    start = prefilter_skip(&lazy->nfa->prefilter, input, start, starts);
+    if (start == starts)
+      break;
+    DState s = lazy->start;
+    for (IdxType i = start; i < len; ++i) {
+      s = lazy_next(lazy, s, input[i]);
+      if (s == DFA_DEAD)
+        break;
+      if (lazy->accepts[s] >= 0)
+        span = (Span){start, i + 1 - start, lazy->accepts[s]};
+    }
+    if (s != DFA_DEAD)
+      *hit_end = true;
+    if (span.pattern >= 0)
+      break;
+  }
+  return span;
+}
+
+/* find the first longest match in input[0, len), see `match_span` */
+Span lazy_match_span(LazyDFA *lazy, char *input, IdxType len) {
+  bool hit_end;
+  return lazy_find(lazy, input, len, len, &hit_end);
+}
+
+/*
+ * find the first longest match, and copy it to (char *)text, return its length
+ */
+IdxType lazy_match(LazyDFA *lazy, char *input, char *text) {
+  return copy_span(input, lazy_match_span(lazy, input, strlen(input)), text);
+}
+
+/* find the next token from g_buffer_ptr without copying it */
+Span lazy_yy_match_span(LazyDFA *lazy) {
+  return yy_advance(lazy_match_span(lazy, g_buffer_ptr, yy_remaining()));
+}
+
+/*
+ * similar to `lazy_match`, but copy to yytext, assign its length to yyleng,
+ * and return the index of the pattern matched
+ */
+int lazy_yy_match(LazyDFA *lazy) { return yy_take(lazy_yy_match_span(lazy)); }
@@ -0,0 +1,190 @@
+#include "match.c"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * literal patterns: a pattern made of chars, concatenations and alternations
+ * only matches a few fixed strings, which are looked up in a trie instead of
+ * going through the NFA. keyword lists don't add a branch to every closure.
+ */
+
+#define LITERAL_MAX_STRINGS 256 /* more strings in a pattern stay in the NFA */
+
+typedef struct TrieNode {
+  int child;   /* first child, -1 if none */
+  int sibling; /* next child of the same parent, -1 if none */
+  int pattern; /* index of the first pattern ending here, -1 if none */
+  char c;
+} TrieNode;
+
+typedef struct Trie {
+  TrieNode *nodes; /* nodes[0] is the root */
+  size_t len;
+  size_t capacity;
+  int root[ALPHABET_SIZE]; /* children of the root by char, -1 if none */
+  Prefilter prefilter;
+} Trie;
+
+/* create a trie with only its root */
+Trie *new_trie() {
+  Trie *trie = (Trie *)malloc(sizeof(Trie));
+  trie->capacity = 16;
+  trie->nodes = (TrieNode *)malloc(trie->capacity * sizeof(TrieNode));
+  trie->nodes[0] = (TrieNode){-1, -1, -1, 0};
+  trie->len = 1;
+  for (int c = 0; c < ALPHABET_SIZE; ++c)
+    trie->root[c] = -1;
+  CharSet none = {{0}};
+  set_prefilter(&trie->prefilter, &none);
+  return trie;
+}
+
+void free_trie(Trie *trie) {
+  free(trie->nodes);
+  free(trie);
+}
+
+/* the child of a node with the char, -1 if none */
+static inline int trie_child(Trie *trie, int node, char c) {
+  if (node == 0)
+    return trie->root[(unsigned char)c];
+  for (int child = trie->nodes[node].child; child >= 0;
+       child = trie->nodes[child].sibling)
+    if (trie->nodes[child].c == c)
+      return child;
+  return -1;
+}
+
+/* add a string of a pattern, an earlier pattern keeps the same string */
+void trie_insert(Trie *trie, char *string, int pattern) {
+  int node = 0;
+  for (char *c = string; *c != '\0'; ++c) {
+    int child = trie_child(trie, node, *c);
+    if (child < 0) {
+      if (trie->len == trie->capacity) {
+        trie->capacity *= 2;
+        trie->nodes =
+            (TrieNode *)realloc(trie->nodes, trie->capacity * sizeof(TrieNode));
+      }
+      child = trie->len++;
+      trie->nodes[child] = (TrieNode){-1, trie->nodes[node].child, -1, *c};
+      trie->nodes[node].child = child;
+      if (node == 0) {
+        trie->root[(unsigned char)*c] = child;
+        CharSet first = trie->prefilter.set;
+        add_char(&first, *c);
+        set_prefilter(&trie->prefilter, &first);
+      }
+    }
+    node = child;
+  }
+  if (node != 0 && trie->nodes[node].pattern < 0)
+    trie->nodes[node].pattern = pattern;
+}
+
+/*
+ * find the first longest match in input[0, len) starting before `starts`,
+ * see `match_span_with` for `hit_end`
+ */
+static Span trie_find(Trie *trie, char *input, IdxType len, IdxType starts,
+                      bool *hit_end) {
+  Span span = {len, 0, -1};
+  *hit_end = false;
+  for (IdxType start = 0; start < starts; ++start) {
+    start = prefilter_skip(&trie->prefilter, input, start, starts);
+    if (start == starts)
+      break;
+    int node = 0;
+    IdxType i = start;
+    for (; i < len; ++i) {
+      node = trie_child(trie, node, input[i]);
+      if (node < 0)
+        break;
+      if (trie->nodes[node].pattern >= 0)
+        span = (Span){start, i + 1 - start, trie->nodes[node].pattern};
+    }
+    if (i == len && node >= 0 && trie->nodes[node].child >= 0)
+      *hit_end = true;
+    if (span.pattern >= 0)
+      break;
+  }
+  return span;
+}
+
+/* find the first longest match in input[0, len), see `match_span` */
+Span trie_match_span(Trie *trie, char *input, IdxType len) {
+  bool hit_end;
+  return trie_find(trie, input, len, len, &hit_end);
+}
+
+/* growable list of strings */
+typedef struct Strings {
+  char **strings;
+  size_t len;
+} Strings;
+
+static void free_strings(Strings *s) {
+  for (size_t i = 0; i < s->len; ++i)
+    free(s->strings[i]);
+  free(s->strings);
+  s->strings = NULL;
+  s->len = 0;
+}
+
+static void push_string(Strings *s, char *string) {
+  s->strings = (char **)realloc(s->strings, (s->len + 1) * sizeof(char *));
+  s->strings[s->len++] = string;
+}
+
+/*
+ * put the strings an AST matches in `out`, return false if it is not a
+ * literal pattern, or matches too many strings
+ */
+static bool expand_literals(Ast *ast, Strings *out) {
+  switch (ast->type) {
+  case LiteralNode: {
+    char *string = (char *)malloc(2);
+    string[0] = ast->data.AstLiteral.value;
+    string[1] = '\0';
+    push_string(out, string);
+    return true;
+  }
+  case SurroundNode:
+    return expand_literals(ast->data.AstSurround.r, out);
+  case OrNode:
+    return expand_literals(ast->data.AstOr.r1, out) &&
+           expand_literals(ast->data.AstOr.r2, out) &&
+           out->len <= LITERAL_MAX_STRINGS;
+  case AndNode: {
+    Strings left = {NULL, 0}, right = {NULL, 0};
+    bool ok = expand_literals(ast->data.AstAnd.r1, &left) &&
+              expand_literals(ast->data.AstAnd.r2, &right) &&
+              out->len + left.len * right.len <= LITERAL_MAX_STRINGS;
+    for (size_t i = 0; ok && i < left.len; ++i)
+      for (size_t j = 0; j < right.len; ++j) {
+        size_t l = strlen(left.strings[i]), r = strlen(right.strings[j]);
+        char *string = (char *)malloc(l + r + 1);
+        memcpy(string, left.strings[i], l);
+        memcpy(string + l, right.strings[j], r + 1);
+        push_string(out, string);
+      }
+    free_strings(&left);
+    free_strings(&right);
+    return ok;
+  }
+  default:
+    return false;
+  }
+}
+
+/* add a pattern to the trie if it is literal, return if it was added */
+bool trie_add_pattern(Trie *trie, Ast *ast, int pattern) {
+  Strings strings = {NULL, 0};
+  bool literal = expand_literals(ast, &strings);
+  for (size_t i = 0; literal && i < strings.len; ++i)
+    trie_insert(trie, strings.strings[i], pattern);
+  free_strings(&strings);
+  return literal;
+}
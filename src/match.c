@@ -1,112 +1,198 @@
-#include "builder.c"
+#include "lazy.c"
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 typedef unsigned long IdxType;
 
-/* if the input string fully matches the pattern */
-bool match_full(NFA *nfa, char *input) {
-  States *s = new_states();
+static int accepted_by(NFA *nfa, States *s);
+
+/*
+ * working memory of matching with an NFA: the current and next states,
+ * swapped after each step. once it has room for the states of an NFA,
+ * matching with it allocates nothing.
+ */
+typedef struct MatchContext {
+  States *s;
+  States *next;
+} MatchContext;
+
+/* create a context with room for the states of an NFA */
+MatchContext *new_match_context(NFA *nfa) {
+  MatchContext *context = (MatchContext *)malloc(sizeof(MatchContext));
+  context->s = new_states_with_capacity(nfa->states_count);
+  context->next = new_states_with_capacity(nfa->states_count);
+  return context;
+}
+
+/* free a context */
+void free_match_context(MatchContext *context) {
+  free_states(context->s);
+  free_states(context->next);
+  free(context);
+}
+
+/* make room for the states of an NFA, finalized first */
+static void reserve_match_context(MatchContext *context, NFA *nfa) {
+  if (!nfa->finalized)
+    finalize_nfa(nfa);
+  reserve_states(context->s, nfa->states_count);
+  reserve_states(context->next, nfa->states_count);
+}
+
+/* same as `match_full`, with the working memory of a context */
+bool match_full_in(MatchContext *context, NFA *nfa, char *input) {
+  if (nfa->bits != NULL)
+    return bitnfa_match_full(nfa->bits, input);
+
+  reserve_match_context(context, nfa);
+  States *s = context->s;
+  States *next = context->next;
+  clear_states(s);
   push_state(s, 0);
-  s = epsilon_closure(nfa, s);
+  close_states(nfa, s);
 
   char *next_char = input;
   while (*next_char != '\0') {
-    s = epsilon_closure(nfa, move(nfa, s, *next_char));
+    step_states(nfa, &s, &next, *next_char);
     ++next_char;
   }
-  bool result = get_shared_states(s, nfa->target_states);
-  free(s);
+  bool result = accepted_by(nfa, s) >= 0;
+  context->s = s;
+  context->next = next;
   return result;
 }
 
-/*
- * find the first longest match, and copy it to (char *)text, return its length
- */
-IdxType match(NFA *nfa, char *input, char *text) {
-  States *s = new_states();
-  push_state(s, 0);
-  s = epsilon_closure(nfa, s);
+/* if the input string fully matches the pattern */
+bool match_full(NFA *nfa, char *input) {
+  MatchContext *context = new_match_context(nfa);
+  bool result = match_full_in(context, nfa, input);
+  free_match_context(context);
+  return result;
+}
 
-  IdxType len = 0;
-  IdxType last_match = 0;
-  char *next_char = input;
-  while (*next_char != '\0') {
-    s = epsilon_closure(nfa, move(nfa, s, *next_char));
-
-    /*
-     * if nothing matches, return to the starting state.
-     * however, if there is any match, stop matching and return it as the
-     * longest match
-     */
-    if (states_is_empty(s)) {
-      if (last_match > 0)
+/* the index of the first pattern whose target state is in s, or -1 */
+static int accepted_by(NFA *nfa, States *s) {
+  for (size_t i = 0; i < nfa->target_states->len; ++i)
+    if (have_state(s, nfa->target_states->states[i]))
+      return target_pattern(nfa, i);
+  return -1;
+}
+
+/* same as `match_span_with`, with the bit-parallel matcher */
+static Span bitnfa_find(NFA *nfa, char *input, IdxType len, IdxType starts,
+                        bool *hit_end) {
+  BitNFA *bits = nfa->bits;
+  Span span = {len, 0, -1};
+  *hit_end = false;
+  for (IdxType start = 0; start < starts; ++start) {
+    start = prefilter_skip(&nfa->prefilter, input, start, starts);
+    if (start == starts)
+      break;
+    uint64_t d = bitnfa_start(bits, input[start]);
+    IdxType i = start;
+    while (d != 0) {
+      int pattern = bitnfa_accepted(bits, d);
+      if (pattern >= 0)
+        span = (Span){start, i + 1 - start, pattern};
+      if (++i == len)
         break;
-      else {
-        push_state(s, 0);
-        s = epsilon_closure(nfa, s);
-      }
-    } else {
-      text[(len)++] = *next_char;
+      d = bitnfa_step(bits, d, input[i]);
     }
-
-    /* if any target state is reached, mark matching */
-    if (get_shared_states(s, nfa->target_states))
-      last_match = len;
-
-    ++next_char;
+    if (d != 0)
+      *hit_end = true;
+    if (span.pattern >= 0)
+      break;
   }
-  len = last_match;
-  text[len] = '\0';
-  free(s);
-  return len;
+  return span;
 }
 
 /*
- * similar to `match`, but copy to yytext, assign its length to yyleng,
- * and return the index of the pattern matched
+ * same as `match_span`, with the caller's containers for current and next,
+ * and only for matches starting in [0, starts). `hit_end` tells if some match
+ * was still possible at the end of the input, so that more input could change
+ * the result.
  */
-#include "util/yy.c"
-int yy_match(NFA *nfa) {
-  States *s = new_states();
-  push_state(s, 0);
-  s = epsilon_closure(nfa, s);
-
-  yyleng = 0;
-  IdxType last_match = 0;
-  State last_shared_state = 0;
-  while (g_buffer_ptr < g_buffer + g_buflen) {
-    s = epsilon_closure(nfa, move(nfa, s, *g_buffer_ptr));
-
-    if (states_is_empty(s)) {
-      if (last_match > 0)
+static Span match_span_with(NFA *nfa, States *s, States *next, char *input,
+                            IdxType len, IdxType starts, bool *hit_end) {
+  if (!nfa->finalized)
+    finalize_nfa(nfa);
+  if (nfa->bits != NULL)
+    return bitnfa_find(nfa, input, len, starts, hit_end);
+  Span span = {len, 0, -1};
+  *hit_end = false;
+  for (IdxType start = 0; start < starts; ++start) {
+    /* no match can start before a char of the prefilter */
+    start = prefilter_skip(&nfa->prefilter, input, start, starts);
+    if (start == starts)
+      break;
+    clear_states(s);
+    push_state(s, 0);
+    close_states(nfa, s);
+    for (IdxType i = start; i < len; ++i) {
+      step_states(nfa, &s, &next, input[i]);
+      if (states_is_empty(s))
         break;
-      else {
-        push_state(s, 0);
-        s = epsilon_closure(nfa, s);
-      }
-    } else {
-      yytext[(yyleng)++] = *g_buffer_ptr;
+      int pattern = accepted_by(nfa, s);
+      if (pattern >= 0)
+        span = (Span){start, i + 1 - start, pattern};
     }
+    if (!states_is_empty(s))
+      *hit_end = true;
+    /* if nothing matches from start, try from the next char */
+    if (span.pattern >= 0)
+      break;
+  }
 
-    /* if any target state is reached, mark matching */
-    if ((last_shared_state = get_shared_states(nfa->target_states, s))) {
-      last_match = yyleng;
-    }
+  return span;
+}
 
-    ++g_buffer_ptr;
-  }
-  yyleng = last_match;
-  yytext[yyleng] = '\0';
+/* same as `match_span`, with the working memory of a context */
+Span match_span_in(MatchContext *context, NFA *nfa, char *input,
+                   IdxType len) {
+  reserve_match_context(context, nfa);
+  bool hit_end;
+  return match_span_with(nfa, context->s, context->next, input, len, len,
+                         &hit_end);
+}
 
-  for (size_t i = 0; i < nfa->target_states->len; ++i) {
-    if (nfa->target_states->states[i] == last_shared_state) {
-      free(s);
-      return i;
-    }
-  }
+/*
+ * find the first longest match in input[0, len) without copying it: the
+ * leftmost position where any pattern matches, and the longest text matched
+ * from there. when several patterns match that text, the first one wins.
+ * this allocates a context for each call, see `match_span_in` for loops.
+ */
+Span match_span(NFA *nfa, char *input, IdxType len) {
+  MatchContext *context = new_match_context(nfa);
+  Span span = match_span_in(context, nfa, input, len);
+  free_match_context(context);
+  return span;
+}
+
+/*
+ * find the first longest match, and copy it to (char *)text, return its length
+ */
+IdxType match(NFA *nfa, char *input, char *text) {
+  return copy_span(input, match_span(nfa, input, strlen(input)), text);
+}
 
-  /* unreachable */
-  exit(EXIT_FAILURE);
+/* working memory of `yy_match_span`, kept like yytext, grown for larger NFAs */
+static MatchContext *g_yy_context = NULL;
+
+/*
+ * find the next token from g_buffer_ptr without copying it: return its span
+ * from g_buffer, and move g_buffer_ptr past it. if nothing matches in the
+ * rest of the buffer, the pattern is -1 and g_buffer_ptr moves to its end.
+ */
+Span yy_match_span(NFA *nfa) {
+  if (g_yy_context == NULL)
+    g_yy_context = new_match_context(nfa);
+  return yy_advance(
+      match_span_in(g_yy_context, nfa, g_buffer_ptr, yy_remaining()));
 }
+
+/*
+ * similar to `match`, but copy to yytext, assign its length to yyleng,
+ * and return the index of the pattern matched, or -1
+ */
+int yy_match(NFA *nfa) { return yy_take(yy_match_span(nfa)); }
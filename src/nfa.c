@@ -6,11 +6,37 @@
 
 char EPSILON = -1;
 
+typedef struct BitNFA BitNFA;
+
 typedef struct NFA {
   State states_count;
+  /*
+   * the states accepting each pattern, in pattern order. the pattern of
+   * target_states->states[i] is target_patterns[i], or i if it is NULL.
+   */
   States *target_states;
-  Edge *edges[MAX];
+  int *target_patterns;
+  Arena *arena; /* labels, edges, and the ASTs the NFA is built from */
+  AstStats ast_stats; /* nodes of the ASTs, see `simplify_asts` */
+  Edge **edges;
   unsigned int edges_count;
+  unsigned int edges_capacity;
+
+  /*
+   * outgoing edges of each state in compressed sparse rows, built by
+   * `finalize_nfa`: the ε-edges of `state` go to
+   * epsilon_to[epsilon_offsets[state] .. epsilon_offsets[state + 1]), and its
+   * other edges are the same range of symbol_labels and symbol_to
+   */
+  bool finalized;
+  unsigned int *epsilon_offsets;
+  State *epsilon_to;
+  unsigned int *symbol_offsets;
+  Label **symbol_labels;
+  State *symbol_to;
+  Prefilter prefilter; /* chars a match can start with, set when finalized */
+
+  BitNFA *bits; /* matcher of small patterns, see bitnfa.c, NULL if none */
 } NFA;
 
 /* create a new NFA */
@@ -18,7 +44,20 @@ NFA *new_nfa() {
   NFA *nfa = (NFA *)malloc(sizeof(NFA));
   nfa->states_count = 0;
   nfa->target_states = NULL;
+  nfa->target_patterns = NULL;
+  nfa->arena = new_arena();
+  nfa->ast_stats = (AstStats){0, 0};
+  nfa->edges = NULL;
   nfa->edges_count = 0;
+  nfa->edges_capacity = 0;
+  nfa->finalized = false;
+  nfa->epsilon_offsets = NULL;
+  nfa->epsilon_to = NULL;
+  nfa->symbol_offsets = NULL;
+  nfa->symbol_labels = NULL;
+  nfa->symbol_to = NULL;
+  nfa->prefilter.count = 256;
+  nfa->bits = NULL;
   return nfa;
 }
 
@@ -30,10 +69,34 @@ void set_states_count(NFA *nfa, State states_count) {
 /* set the target states of an NFA */
 void set_target_states(NFA *nfa, States *s) { nfa->target_states = s; }
 
+/* the pattern accepted by the i-th target state */
+static inline int target_pattern(NFA *nfa, size_t i) {
+  return nfa->target_patterns == NULL ? (int)i : nfa->target_patterns[i];
+}
+
 /* add an edge to an NFA */
 void push_edge(NFA *nfa, Edge *e) {
+  if (nfa->edges_count == nfa->edges_capacity) {
+    nfa->edges_capacity = nfa->edges_capacity * 2 + 8;
+    nfa->edges =
+        (Edge **)realloc(nfa->edges, nfa->edges_capacity * sizeof(Edge *));
+  }
   nfa->edges[nfa->edges_count] = e;
   ++(nfa->edges_count);
+  nfa->finalized = false;
+  /* the matcher of the patterns doesn't know the edge */
+  free(nfa->bits);
+  nfa->bits = NULL;
+}
+
+/* print a char of a set label */
+static void print_char(int c) {
+  if (c == '\n')
+    printf("↵");
+  else if (c < 0x20 || c >= 0x7f)
+    printf("\\x%02x", c);
+  else
+    printf("%c", c);
 }
 
 /* print edges in the form of `from --symbol--> to` */
@@ -48,103 +111,210 @@ void print_edges(NFA *nfa) {
         printf("%2d ---ε---> %2d\n", e->from, e->to);
       else
         printf("%2d ---%c---> %2d\n", e->from, symbol, e->to);
-    } else if (l->type == SET || NEG_SET) {
-      printf("%2d --", e->from);
-      if (l->type == NEG_SET)
-        printf("^");
-      for (size_t i = 0; i < e->label->data.set->size; ++i) {
-        char c = e->label->data.set->data[i];
-        if (c == '\n')
-          printf("↵");
-        else
-          printf("%c", c);
+    } else if (l->type == SET) {
+      printf("%2d --[", e->from);
+      /* print runs of chars as ranges */
+      for (int c = 0; c < 256; ++c) {
+        if (!have_char(l->data.set, (char)c))
+          continue;
+        int to = c;
+        while (to < 255 && have_char(l->data.set, (char)(to + 1)))
+          ++to;
+        print_char(c);
+        if (to > c) {
+          printf("-");
+          print_char(to);
+        }
+        c = to;
       }
-      printf("--> %2d\n", e->to);
+      printf("]--> %2d\n", e->to);
     }
   }
 }
 
+/* free the adjacency rows of an NFA */
+static void free_adjacency(NFA *nfa) {
+  free(nfa->epsilon_offsets);
+  free(nfa->epsilon_to);
+  free(nfa->symbol_offsets);
+  free(nfa->symbol_labels);
+  free(nfa->symbol_to);
+  nfa->finalized = false;
+}
+
 /* free an NFA */
 void free_nfa(NFA *nfa) {
-  /* free edges */
-  for (size_t i = 0; i < nfa->edges_count; ++i) {
-    free(nfa->edges[i]->label);
-    free(nfa->edges[i]);
-  }
+  free_adjacency(nfa);
+  free(nfa->bits);
+  free_arena(nfa->arena);
+  free(nfa->edges);
   /* free target states */
   if (nfa->target_states != NULL) {
-    free(nfa->target_states);
+    free_states(nfa->target_states);
   }
+  free(nfa->target_patterns);
   /* free nfa */
   free(nfa);
   nfa = NULL;
 }
 
+/* if the label is an ε */
+static bool is_epsilon(Label *label) {
+  return label->type == CHAR && label->data.symbol == EPSILON;
+}
+
+/* if the label accepts the input symbol, ε-labels accept no symbol */
 static bool accept(Label *label, char input) {
-  if (input == EPSILON)
-    return label->type == CHAR && label->data.symbol == EPSILON;
+  if (is_epsilon(label))
+    return false;
 
   switch (label->type) {
   case CHAR:
     return input == label->data.symbol;
   case SET:
-    for (size_t i = 0; i < label->data.set->size; ++i)
-      if (label->data.set->data[i] == input)
-        return true;
-    return false;
-  case NEG_SET:
-    for (size_t i = 0; i < label->data.set->size; ++i)
-      if (label->data.set->data[i] == input)
-        return false;
-    return true;
+    return have_char(label->data.set, input);
   }
   exit(EXIT_FAILURE);
 }
 
-/* return all states reachable with epsilon labels from the given states */
-States *epsilon_closure(NFA *nfa, States *s) {
-  States *new_s = new_states();
+static void set_first_chars(NFA *nfa);
 
-  /* add all original states to the closure first */
-  for (size_t i = 0; i < s->len; ++i) {
-    push_state(new_s, s->states[i]);
+/*
+ * lay the edges out by `from` state, with ε-edges apart from the others, so
+ * that each state only visits its own outgoing edges. called after building,
+ * and again by matching functions if edges were pushed since.
+ */
+void finalize_nfa(NFA *nfa) {
+  free_adjacency(nfa);
+
+  /* states may be added by hand without updating the count */
+  for (size_t i = 0; i < nfa->edges_count; ++i) {
+    Edge *e = nfa->edges[i];
+    if (e->from >= nfa->states_count)
+      nfa->states_count = e->from + 1;
+    if (e->to >= nfa->states_count)
+      nfa->states_count = e->to + 1;
   }
 
-  /* simulate the original states as a stack */
-  while (s->len > 0) {
-    --(s->len);
-    State state = s->states[s->len];
-    for (size_t i = 0; i < nfa->edges_count; ++i) {
-      Edge *e = nfa->edges[i];
-      if (e->from == state && accept(e->label, EPSILON)) {
-        State next_state = e->to;
-        if (!have_state(new_s, next_state)) {
-          push_state(new_s, next_state);
-          s->states[s->len] = next_state;
-          ++(s->len);
-        }
-      }
+  size_t n = nfa->states_count;
+  nfa->epsilon_offsets = (unsigned int *)calloc(n + 1, sizeof(unsigned int));
+  nfa->symbol_offsets = (unsigned int *)calloc(n + 1, sizeof(unsigned int));
+  for (size_t i = 0; i < nfa->edges_count; ++i) {
+    Edge *e = nfa->edges[i];
+    if (is_epsilon(e->label))
+      ++nfa->epsilon_offsets[e->from + 1];
+    else
+      ++nfa->symbol_offsets[e->from + 1];
+  }
+  for (size_t i = 0; i < n; ++i) {
+    nfa->epsilon_offsets[i + 1] += nfa->epsilon_offsets[i];
+    nfa->symbol_offsets[i + 1] += nfa->symbol_offsets[i];
+  }
+
+  unsigned int epsilon_count = nfa->epsilon_offsets[n];
+  unsigned int symbol_count = nfa->symbol_offsets[n];
+  nfa->epsilon_to = (State *)malloc((epsilon_count + 1) * sizeof(State));
+  nfa->symbol_labels = (Label **)malloc((symbol_count + 1) * sizeof(Label *));
+  nfa->symbol_to = (State *)malloc((symbol_count + 1) * sizeof(State));
+
+  /* fill each row in edge order, using the row ends as cursors */
+  unsigned int *epsilon_fill = (unsigned int *)malloc(n * sizeof(unsigned int));
+  unsigned int *symbol_fill = (unsigned int *)malloc(n * sizeof(unsigned int));
+  for (size_t i = 0; i < n; ++i) {
+    epsilon_fill[i] = nfa->epsilon_offsets[i];
+    symbol_fill[i] = nfa->symbol_offsets[i];
+  }
+  for (size_t i = 0; i < nfa->edges_count; ++i) {
+    Edge *e = nfa->edges[i];
+    if (is_epsilon(e->label)) {
+      nfa->epsilon_to[epsilon_fill[e->from]++] = e->to;
+    } else {
+      unsigned int j = symbol_fill[e->from]++;
+      nfa->symbol_labels[j] = e->label;
+      nfa->symbol_to[j] = e->to;
     }
   }
+  free(epsilon_fill);
+  free(symbol_fill);
 
-  free(s);
-  return new_s;
+  nfa->finalized = true;
+  set_first_chars(nfa);
 }
 
-/* return all states reachable with given symbol from the given states */
-States *move(NFA *nfa, States *s, char symbol) {
-  States *new_s = new_states();
+/* add all states reachable with epsilon labels to the given states */
+void close_states(NFA *nfa, States *s) {
+  if (!nfa->finalized)
+    finalize_nfa(nfa);
+
+  /* the states pushed at the end are visited as a queue */
   for (size_t i = 0; i < s->len; ++i) {
-    for (size_t j = 0; j < nfa->edges_count; ++j) {
-      Edge *e = nfa->edges[j];
-      if (e->from == s->states[i] && accept(e->label, symbol)) {
-        State next_state = e->to;
-        if (!have_state(new_s, next_state)) {
-          push_state(new_s, next_state);
-        }
+    State state = s->states[i];
+    for (unsigned int j = nfa->epsilon_offsets[state];
+         j < nfa->epsilon_offsets[state + 1]; ++j)
+      push_state(s, nfa->epsilon_to[j]);
+  }
+}
+
+/* find the chars the start state can move with, for `nfa->prefilter` */
+static void set_first_chars(NFA *nfa) {
+  CharSet first = {{0}};
+  if (nfa->states_count > 0) {
+    States *s = new_states_with_capacity(nfa->states_count);
+    push_state(s, 0);
+    close_states(nfa, s);
+    for (size_t i = 0; i < s->len; ++i) {
+      State state = s->states[i];
+      for (unsigned int j = nfa->symbol_offsets[state];
+           j < nfa->symbol_offsets[state + 1]; ++j) {
+        Label *label = nfa->symbol_labels[j];
+        if (label->type == CHAR)
+          add_char(&first, label->data.symbol);
+        else
+          union_charset(&first, label->data.set);
       }
     }
+    free_states(s);
   }
-  free(s);
+  set_prefilter(&nfa->prefilter, &first);
+}
+
+/* put all states reachable with given symbol from the given states in next */
+void move_states(NFA *nfa, States *s, char symbol, States *next) {
+  if (!nfa->finalized)
+    finalize_nfa(nfa);
+
+  clear_states(next);
+  for (size_t i = 0; i < s->len; ++i) {
+    State state = s->states[i];
+    for (unsigned int j = nfa->symbol_offsets[state];
+         j < nfa->symbol_offsets[state + 1]; ++j)
+      if (accept(nfa->symbol_labels[j], symbol))
+        push_state(next, nfa->symbol_to[j]);
+  }
+}
+
+/*
+ * move the current states `*s` with the symbol and close them, then swap the
+ * containers so that `*s` holds the result, nothing is allocated
+ */
+void step_states(NFA *nfa, States **s, States **next, char symbol) {
+  move_states(nfa, *s, symbol, *next);
+  close_states(nfa, *next);
+  States *tmp = *s;
+  *s = *next;
+  *next = tmp;
+}
+
+/* return all states reachable with epsilon labels from the given states */
+States *epsilon_closure(NFA *nfa, States *s) {
+  close_states(nfa, s);
+  return s;
+}
+
+/* return all states reachable with given symbol from the given states */
+States *move(NFA *nfa, States *s, char symbol) {
+  States *new_s = new_states_with_capacity(nfa->states_count);
+  move_states(nfa, s, symbol, new_s);
+  free_states(s);
   return new_s;
 }
@@ -0,0 +1,135 @@
+#include "scanner.c"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/*
+ * parallel scanning: the buffer is cut into one chunk per thread, and each
+ * thread scans its chunk as if a token started at the chunk start. tokens
+ * are then stitched in order: where the real scan enters a chunk at a
+ * position the speculative scan also reached, both scans are the same from
+ * there on; otherwise the chunk is scanned again from the real position
+ * until the two meet.
+ */
+
+/* called for each token, with the buffer scanned and the span of the token */
+typedef void (*TokenCallback)(char *buffer, Span span, void *data);
+
+typedef struct Chunk {
+  Automaton *automaton;
+  char *buffer;
+  IdxType buflen;
+  IdxType begin; /* tokens starting in [begin, end) belong to the chunk */
+  IdxType end;
+  Span *tokens;
+  size_t tokens_len;
+  size_t tokens_capacity;
+} Chunk;
+
+static void push_token(Chunk *chunk, Span span) {
+  if (chunk->tokens_len == chunk->tokens_capacity) {
+    chunk->tokens_capacity = chunk->tokens_capacity * 2 + 16;
+    chunk->tokens = (Span *)realloc(chunk->tokens,
+                                    chunk->tokens_capacity * sizeof(Span));
+  }
+  chunk->tokens[chunk->tokens_len++] = span;
+}
+
+/* scan a chunk from its beginning, tokens may end past the chunk */
+static void *scan_chunk(void *arg) {
+  Chunk *chunk = (Chunk *)arg;
+  Scanner *scanner = new_scanner(chunk->automaton);
+  scanner_set_buffer(scanner, chunk->buffer, chunk->buflen);
+  scanner->buffer_ptr = chunk->buffer + chunk->begin;
+  while (!scanner_is_done(scanner)) {
+    Span span = scanner_match_span(scanner);
+    if (span.pattern < 0 || span.start >= chunk->end)
+      break;
+    push_token(chunk, span);
+  }
+  free_scanner(scanner);
+  return NULL;
+}
+
+/*
+ * scan the buffer with `nthreads` threads and call `callback` for each token
+ * in order, with the same tokens as a loop of `scanner_match_span`
+ */
+void scan_parallel(Automaton *automaton, char *buffer, IdxType len,
+                   size_t nthreads, TokenCallback callback, void *data) {
+  if (nthreads == 0)
+    nthreads = 1;
+  if (nthreads > len)
+    nthreads = len > 0 ? len : 1;
+
+  Chunk *chunks = (Chunk *)malloc(nthreads * sizeof(Chunk));
+  pthread_t *threads = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+  for (size_t i = 0; i < nthreads; ++i) {
+    chunks[i].automaton = automaton;
+    chunks[i].buffer = buffer;
+    chunks[i].buflen = len;
+    chunks[i].begin = len * i / nthreads;
+    chunks[i].end = len * (i + 1) / nthreads;
+    chunks[i].tokens = NULL;
+    chunks[i].tokens_len = 0;
+    chunks[i].tokens_capacity = 0;
+  }
+  /*
+   * the first chunk, and the chunks no thread could be created for, are
+   * scanned by this thread
+   */
+  bool *created = (bool *)calloc(nthreads, sizeof(bool));
+  for (size_t i = 1; i < nthreads; ++i)
+    created[i] = pthread_create(&threads[i], NULL, scan_chunk, &chunks[i]) == 0;
+  for (size_t i = 0; i < nthreads; ++i)
+    if (!created[i])
+      scan_chunk(&chunks[i]);
+  for (size_t i = 1; i < nthreads; ++i)
+    if (created[i])
+      pthread_join(threads[i], NULL);
+  free(created);
+
+  /* stitch, `position` is where the real scan goes on */
+  Scanner *scanner = new_scanner(automaton);
+  scanner_set_buffer(scanner, buffer, len);
+  IdxType position = 0;
+  for (size_t i = 0; i < nthreads; ++i) {
+    Chunk *chunk = &chunks[i];
+    size_t t = 0; /* first speculative token not before position */
+    for (;;) {
+      while (t < chunk->tokens_len &&
+             chunk->tokens[t].start + chunk->tokens[t].len <= position &&
+             chunk->tokens[t].start < position)
+        ++t;
+      bool synced = position == chunk->begin ||
+                    (t > 0 && chunk->tokens[t - 1].start +
+                                      chunk->tokens[t - 1].len ==
+                                  position);
+      if (synced || position >= chunk->end)
+        break;
+
+      /* out of sync, scan one token for real */
+      scanner->buffer_ptr = buffer + position;
+      Span span = scanner_match_span(scanner);
+      if (span.pattern < 0 || span.start >= chunk->end) {
+        position = chunk->end;
+        t = chunk->tokens_len;
+        break;
+      }
+      callback(buffer, span, data);
+      position = span.start + span.len;
+    }
+
+    if (position < chunk->end || position == chunk->begin) {
+      for (; t < chunk->tokens_len; ++t) {
+        callback(buffer, chunk->tokens[t], data);
+        position = chunk->tokens[t].start + chunk->tokens[t].len;
+      }
+    }
+    free(chunk->tokens);
+  }
+  free_scanner(scanner);
+  free(chunks);
+  free(threads);
+}
@@ -0,0 +1,325 @@
+#include "literal.c"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * reentrant scanning: an Automaton is compiled once and never changes, so
+ * it can be shared by threads; each Scanner keeps the buffer, the last
+ * token and the working memory of one scan.
+ *
+ * the input is either a buffer given whole, or a stream read through a
+ * refill function into a buffer owned by the scanner, see `scanner_set_input`.
+ */
+
+#define LAZY_DEFAULT_BUDGET (1 << 20)
+
+typedef enum Engine {
+  ENGINE_NFA,
+  ENGINE_DFA,      /* minimized DFA built up front */
+  ENGINE_LAZY_DFA, /* DFA states built while scanning, one cache per scanner */
+} Engine;
+
+typedef struct Automaton {
+  Engine engine;
+  /* literal patterns with ENGINE_NFA, see literal.c, NULL if none */
+  Trie *trie;
+  /* the other patterns, with the index of each one in the compiled patterns */
+  NFA *nfa;
+  DFA *dfa; /* NULL unless the engine is ENGINE_DFA */
+  int *nfa_patterns;
+  size_t nfa_patterns_len;
+  size_t lazy_budget; /* cache budget of each scanner for ENGINE_LAZY_DFA */
+} Automaton;
+
+/*
+ * compile patterns for an engine, the first pattern has the highest priority.
+ * with ENGINE_NFA, literal patterns go to a trie, and the others to the
+ * engine. the DFA engines take all patterns: a DFA matches keywords as fast
+ * as a trie, and merging the matches of both would only slow them down.
+ */
+Automaton *compile(char **patterns, size_t len, Engine engine) {
+  Automaton *automaton = (Automaton *)malloc(sizeof(Automaton));
+  automaton->engine = engine;
+  automaton->trie = new_trie();
+  char **regexes = (char **)malloc((len + 1) * sizeof(char *));
+  automaton->nfa_patterns = (int *)malloc((len + 1) * sizeof(int));
+  automaton->nfa_patterns_len = 0;
+  Arena *arena = new_arena();
+  for (size_t i = 0; i < len; ++i) {
+    Ast *ast = engine == ENGINE_NFA ? parse_pattern(arena, patterns[i]) : NULL;
+    if (ast == NULL || !trie_add_pattern(automaton->trie, ast, i)) {
+      regexes[automaton->nfa_patterns_len] = patterns[i];
+      automaton->nfa_patterns[automaton->nfa_patterns_len++] = i;
+    }
+    clear_arena(arena);
+  }
+  free_arena(arena);
+  if (automaton->trie->len == 1) {
+    free_trie(automaton->trie);
+    automaton->trie = NULL;
+  }
+
+  automaton->nfa = build_many(regexes, automaton->nfa_patterns_len);
+  free(regexes);
+  automaton->dfa = NULL;
+  automaton->lazy_budget = LAZY_DEFAULT_BUDGET;
+  if (engine == ENGINE_DFA) {
+    automaton->dfa = nfa2dfa(automaton->nfa);
+    dfa_minimize(automaton->dfa);
+  }
+  return automaton;
+}
+
+/* free an automaton, after all of its scanners */
+void free_automaton(Automaton *automaton) {
+  if (automaton->trie != NULL)
+    free_trie(automaton->trie);
+  if (automaton->dfa != NULL)
+    free_dfa(automaton->dfa);
+  free_nfa(automaton->nfa);
+  free(automaton->nfa_patterns);
+  free(automaton);
+}
+
+/*
+ * read at most `max` bytes of input into `buffer` and return how many were
+ * read, 0 at the end of input, like YY_INPUT of lex
+ */
+typedef IdxType (*Refill)(char *buffer, IdxType max, void *data);
+
+typedef struct Scanner {
+  Automaton *automaton;
+  /* input */
+  char *buffer;
+  char *buffer_ptr;
+  IdxType buflen;
+  IdxType offset; /* position of the buffer start in the whole input */
+  /* streaming input, `refill` is NULL for a buffer given whole */
+  Refill refill;
+  void *refill_data;
+  IdxType buffer_capacity;
+  bool eof;
+  /* the last token, copied by `scanner_match` */
+  char *yytext;
+  IdxType yyleng;
+  IdxType yytext_capacity;
+  /* working memory */
+  States *s; /* current and next states of ENGINE_NFA */
+  States *next;
+  LazyDFA *lazy; /* cache of ENGINE_LAZY_DFA */
+  /*
+   * the last trie search, from `trie_from` to the end of the buffer: until
+   * its match is passed, a search from later gives the same match
+   */
+  char *trie_from;
+  Span trie_span;
+  bool trie_hit_end;
+} Scanner;
+
+/* create a scanner for an automaton, with an empty buffer */
+Scanner *new_scanner(Automaton *automaton) {
+  Scanner *scanner = (Scanner *)malloc(sizeof(Scanner));
+  scanner->automaton = automaton;
+  scanner->buffer = NULL;
+  scanner->buffer_ptr = NULL;
+  scanner->buflen = 0;
+  scanner->offset = 0;
+  scanner->refill = NULL;
+  scanner->refill_data = NULL;
+  scanner->buffer_capacity = 0;
+  scanner->eof = true;
+  scanner->yytext_capacity = 16;
+  scanner->yytext = (char *)malloc(scanner->yytext_capacity);
+  scanner->yytext[0] = '\0';
+  scanner->yyleng = 0;
+
+  State states_count = automaton->nfa->states_count;
+  scanner->s = new_states_with_capacity(states_count);
+  scanner->next = new_states_with_capacity(states_count);
+  scanner->lazy = NULL;
+  scanner->trie_from = NULL;
+  if (automaton->engine == ENGINE_LAZY_DFA)
+    scanner->lazy = new_lazy_dfa(automaton->nfa, automaton->lazy_budget);
+  return scanner;
+}
+
+/* free a scanner, the automaton and a buffer given whole are not freed */
+void free_scanner(Scanner *scanner) {
+  if (scanner->refill != NULL)
+    free(scanner->buffer);
+  free(scanner->yytext);
+  free_states(scanner->s);
+  free_states(scanner->next);
+  if (scanner->lazy != NULL)
+    free_lazy_dfa(scanner->lazy);
+  free(scanner);
+}
+
+/* scan a new buffer from its beginning */
+void scanner_set_buffer(Scanner *scanner, char *buffer, IdxType len) {
+  if (scanner->refill != NULL)
+    free(scanner->buffer);
+  scanner->buffer = buffer;
+  scanner->buffer_ptr = buffer;
+  scanner->buflen = len;
+  scanner->offset = 0;
+  scanner->refill = NULL;
+  scanner->refill_data = NULL;
+  scanner->buffer_capacity = 0;
+  scanner->eof = true;
+  scanner->trie_from = NULL;
+}
+
+/*
+ * scan a stream read by `refill`, through a buffer of `capacity` bytes which
+ * only grows for a token longer than it
+ */
+void scanner_set_input(Scanner *scanner, Refill refill, void *data,
+                       IdxType capacity) {
+  scanner_set_buffer(scanner, NULL, 0);
+  if (capacity == 0)
+    capacity = 1;
+  scanner->buffer = (char *)malloc(capacity);
+  scanner->buffer_ptr = scanner->buffer;
+  scanner->buffer_capacity = capacity;
+  scanner->refill = refill;
+  scanner->refill_data = data;
+  scanner->eof = false;
+}
+
+/*
+ * read more input after the buffer, dropping what is before buffer_ptr, and
+ * growing the buffer only when it is full with text not scanned yet
+ */
+static void scanner_refill(Scanner *scanner) {
+  IdxType kept = scanner->buffer + scanner->buflen - scanner->buffer_ptr;
+  IdxType dropped = scanner->buffer_ptr - scanner->buffer;
+  memmove(scanner->buffer, scanner->buffer_ptr, kept);
+  scanner->offset += dropped;
+  scanner->buflen = kept;
+  scanner->buffer_ptr = scanner->buffer;
+  scanner->trie_from = NULL;
+  if (kept == scanner->buffer_capacity) {
+    scanner->buffer_capacity *= 2;
+    scanner->buffer =
+        (char *)realloc(scanner->buffer, scanner->buffer_capacity);
+    scanner->buffer_ptr = scanner->buffer;
+  }
+
+  IdxType read =
+      scanner->refill(scanner->buffer + kept,
+                      scanner->buffer_capacity - kept, scanner->refill_data);
+  if (read == 0)
+    scanner->eof = true;
+  scanner->buflen += read;
+}
+
+/* if the whole input has been scanned */
+bool scanner_is_done(Scanner *scanner) {
+  while (scanner->buffer_ptr >= scanner->buffer + scanner->buflen &&
+         !scanner->eof)
+    scanner_refill(scanner);
+  return scanner->buffer_ptr >= scanner->buffer + scanner->buflen;
+}
+
+/* find a match of the patterns not in the trie with the scanner's engine */
+static Span scanner_find_engine(Scanner *scanner, char *input, IdxType len,
+                                IdxType starts, bool *hit_end) {
+  Automaton *automaton = scanner->automaton;
+  switch (automaton->engine) {
+  case ENGINE_NFA:
+    return match_span_with(automaton->nfa, scanner->s, scanner->next, input,
+                           len, starts, hit_end);
+  case ENGINE_DFA:
+    return dfa_find(automaton->dfa, input, len, starts, hit_end);
+  case ENGINE_LAZY_DFA:
+    return lazy_find(scanner->lazy, input, len, starts, hit_end);
+  }
+  exit(EXIT_FAILURE);
+}
+
+/*
+ * find the first longest match in input[0, len) with the trie and the engine,
+ * see `match_span_with` for `hit_end`
+ */
+static Span scanner_find(Scanner *scanner, char *input, IdxType len,
+                         bool *hit_end) {
+  Automaton *automaton = scanner->automaton;
+  Span span = {len, 0, -1};
+  *hit_end = false;
+  IdxType starts = len;
+  if (automaton->trie != NULL) {
+    char *from = scanner->trie_from;
+    if (from == NULL || from > input ||
+        (scanner->trie_span.pattern >= 0 &&
+         from + scanner->trie_span.start < input)) {
+      from = scanner->trie_from = input;
+      scanner->trie_span =
+          trie_find(automaton->trie, input, len, len, &scanner->trie_hit_end);
+    }
+    span = scanner->trie_span;
+    span.start -= input - from;
+    *hit_end = scanner->trie_hit_end;
+    /* the engine only has to look for matches starting no later */
+    if (span.pattern >= 0)
+      starts = span.start + 1;
+  }
+  if (automaton->nfa_patterns_len == 0)
+    return span;
+
+  bool engine_hit_end;
+  Span other =
+      scanner_find_engine(scanner, input, len, starts, &engine_hit_end);
+  *hit_end = *hit_end || engine_hit_end;
+  if (other.pattern < 0)
+    return span;
+  other.pattern = automaton->nfa_patterns[other.pattern];
+  if (span.pattern < 0 || other.start < span.start ||
+      (other.start == span.start &&
+       (other.len > span.len ||
+        (other.len == span.len && other.pattern < span.pattern))))
+    return other;
+  return span;
+}
+
+/*
+ * find the next token without copying it, same as `yy_match_span`: return its
+ * span from the start of the input and move past it. a stream is refilled
+ * until the token can't grow any longer.
+ */
+Span scanner_match_span(Scanner *scanner) {
+  for (;;) {
+    IdxType position = scanner->buffer_ptr - scanner->buffer;
+    bool hit_end;
+    Span span = scanner_find(scanner, scanner->buffer_ptr,
+                             scanner->buflen - position, &hit_end);
+    if (scanner->eof || (!hit_end && span.pattern >= 0)) {
+      span.start += position;
+      scanner->buffer_ptr = scanner->buffer + span.start + span.len;
+      span.start += scanner->offset;
+      return span;
+    }
+    /* nothing in the buffer can start a token, a token may start after it */
+    if (!hit_end)
+      scanner->buffer_ptr = scanner->buffer + scanner->buflen;
+    scanner_refill(scanner);
+  }
+}
+
+/*
+ * find the next token, same as `yy_match`: copy it to yytext, assign its
+ * length to yyleng, and return the index of the pattern matched, or -1
+ */
+int scanner_match(Scanner *scanner) {
+  Span span = scanner_match_span(scanner);
+  if (span.len + 1 > scanner->yytext_capacity) {
+    scanner->yytext_capacity = (span.len + 1) * 2;
+    scanner->yytext =
+        (char *)realloc(scanner->yytext, scanner->yytext_capacity);
+  }
+  Span text = {span.start - scanner->offset, span.len, span.pattern};
+  scanner->yyleng = copy_span(scanner->buffer, text, scanner->yytext);
+  return span.pattern;
+}
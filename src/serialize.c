@@ -0,0 +1,154 @@
+#include "dfa.c"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * DFA files: a header, then the byte classes, the transitions and the
+ * accepted patterns, laid out as in memory. `load_dfa` maps the file and
+ * points the DFA into it, so nothing is parsed or copied. numbers are in
+ * the byte order of the machine that saved the file.
+ */
+
+#define DFA_FILE_MAGIC "re-dfa\0"
+#define DFA_FILE_VERSION 1
+
+typedef struct DFAFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t states_count;
+  uint32_t start;
+  uint32_t classes_count;
+  uint64_t payload_len; /* bytes after the header */
+  uint64_t checksum;    /* FNV-1a of the bytes after the header */
+  unsigned char prefilter[32];
+} DFAFileHeader;
+
+static uint64_t checksum_bytes(unsigned char *bytes, size_t len) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/* bytes of the transitions and accepted patterns of a DFA */
+static size_t transitions_len(DFA *dfa) {
+  return (size_t)dfa->states_count * dfa->classes_count * sizeof(DState);
+}
+
+static size_t accepts_len(DFA *dfa) {
+  return (size_t)dfa->states_count * sizeof(int);
+}
+
+/* write a DFA to a file, return 0, or -1 with errno set */
+int save_dfa(DFA *dfa, char *path) {
+  size_t payload_len = ALPHABET_SIZE + transitions_len(dfa) + accepts_len(dfa);
+  unsigned char *payload = (unsigned char *)malloc(payload_len);
+  memcpy(payload, dfa->classes, ALPHABET_SIZE);
+  memcpy(payload + ALPHABET_SIZE, dfa->transitions, transitions_len(dfa));
+  memcpy(payload + ALPHABET_SIZE + transitions_len(dfa), dfa->accepts,
+         accepts_len(dfa));
+
+  DFAFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, DFA_FILE_MAGIC, sizeof(header.magic));
+  header.version = DFA_FILE_VERSION;
+  header.states_count = dfa->states_count;
+  header.start = dfa->start;
+  header.classes_count = dfa->classes_count;
+  header.payload_len = payload_len;
+  header.checksum = checksum_bytes(payload, payload_len);
+  memcpy(header.prefilter, dfa->prefilter.set.bits, 32);
+
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    free(payload);
+    return -1;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(payload, payload_len, 1, file) == 1;
+  free(payload);
+  if (fclose(file) != 0 || !ok)
+    return -1;
+  return 0;
+}
+
+/* unmap the file of a loaded DFA */
+static void unmap_dfa(DFA *dfa) { munmap(dfa->mapping, dfa->mapping_len); }
+
+/*
+ * map a DFA saved by `save_dfa`, return NULL with errno set if the file
+ * can't be read, or EINVAL if it is not a valid DFA file
+ */
+DFA *load_dfa(char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return NULL;
+  }
+  size_t len = st.st_size;
+  if (len < sizeof(DFAFileHeader)) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+  unsigned char *mapping =
+      (unsigned char *)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return NULL;
+
+  DFAFileHeader *header = (DFAFileHeader *)mapping;
+  DFA dfa = {0};
+  dfa.states_count = header->states_count;
+  dfa.classes_count = header->classes_count;
+  unsigned char *payload = mapping + sizeof(DFAFileHeader);
+  bool valid =
+      memcmp(header->magic, DFA_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+      header->version == DFA_FILE_VERSION &&
+      header->payload_len == len - sizeof(DFAFileHeader) &&
+      header->classes_count >= 1 && header->classes_count <= ALPHABET_SIZE &&
+      header->start < header->states_count &&
+      header->payload_len ==
+          ALPHABET_SIZE + transitions_len(&dfa) + accepts_len(&dfa) &&
+      header->checksum == checksum_bytes(payload, header->payload_len);
+  /* tables pointing out of the DFA would read out of the mapping */
+  for (size_t c = 0; valid && c < ALPHABET_SIZE; ++c)
+    valid = payload[c] < header->classes_count;
+  DState *transitions = (DState *)(payload + ALPHABET_SIZE);
+  size_t transitions_count = transitions_len(&dfa) / sizeof(DState);
+  for (size_t i = 0; valid && i < transitions_count; ++i)
+    valid = transitions[i] < header->states_count;
+  if (!valid) {
+    munmap(mapping, len);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  DFA *loaded = new_dfa();
+  loaded->states_count = header->states_count;
+  loaded->start = header->start;
+  loaded->classes_count = header->classes_count;
+  memcpy(loaded->classes, payload, ALPHABET_SIZE);
+  loaded->transitions = (DState *)(payload + ALPHABET_SIZE);
+  loaded->accepts =
+      (int *)(payload + ALPHABET_SIZE + transitions_len(loaded));
+  CharSet first;
+  memcpy(first.bits, header->prefilter, 32);
+  set_prefilter(&loaded->prefilter, &first);
+  loaded->mapping = mapping;
+  loaded->mapping_len = len;
+  return loaded;
+}
@@ -2,47 +2,128 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define MAX 999
+typedef unsigned int State;
 
-typedef unsigned short State;
+/* a container without a capacity keeps up to this many states in a list */
+#define STATES_LIST_MAX 16
 
+/*
+ * sparse set of states: `states` holds the members in insertion order, and
+ * `sparse[state]` is the index of `state` in `states`. insertion, membership
+ * test and clearing are all O(1).
+ *
+ * a container created without a capacity is a short list searched linearly,
+ * with no `sparse`, until it has more than STATES_LIST_MAX states, so that
+ * small containers of large state ids stay small.
+ */
 typedef struct States {
-  State states[MAX];
+  State *states;
+  State *sparse; /* NULL while the container is a list */
   size_t len;
+  size_t capacity; /* states in [0, capacity) fit without growing */
 } States;
 
-/* create an empty container of states */
-States *new_states() {
+/* create an empty container for states in [0, capacity) */
+States *new_states_with_capacity(size_t capacity) {
   States *s = (States *)malloc(sizeof(States));
   s->len = 0;
+  s->capacity = capacity;
+  if (capacity == 0) {
+    s->states = (State *)malloc(STATES_LIST_MAX * sizeof(State));
+    s->sparse = NULL;
+    return s;
+  }
+  s->states = (State *)malloc((capacity + 1) * sizeof(State));
+  s->sparse = (State *)calloc(capacity + 1, sizeof(State));
   return s;
 }
 
-/* push a state into the container */
+/* create an empty container of states */
+States *new_states() { return new_states_with_capacity(0); }
+
+/* free a container of states */
+void free_states(States *s) {
+  free(s->states);
+  free(s->sparse);
+  free(s);
+}
+
+/* make room for states in [0, capacity), a list becomes a sparse set */
+static void reserve_states(States *s, size_t capacity) {
+  if (s->sparse == NULL) {
+    for (size_t i = 0; i < s->len; ++i)
+      if (s->states[i] >= capacity)
+        capacity = (size_t)s->states[i] + 1;
+    s->states = (State *)realloc(s->states, (capacity + 1) * sizeof(State));
+    s->sparse = (State *)calloc(capacity + 1, sizeof(State));
+    for (size_t i = 0; i < s->len; ++i)
+      s->sparse[s->states[i]] = i;
+    s->capacity = capacity;
+    return;
+  }
+  if (capacity <= s->capacity)
+    return;
+  if (capacity < s->capacity * 2)
+    capacity = s->capacity * 2;
+  s->states = (State *)realloc(s->states, (capacity + 1) * sizeof(State));
+  s->sparse = (State *)realloc(s->sparse, (capacity + 1) * sizeof(State));
+  memset(s->sparse + s->capacity, 0,
+         (capacity - s->capacity + 1) * sizeof(State));
+  s->capacity = capacity;
+}
+
+/* if the container has the state */
+bool have_state(States *s, State state) {
+  if (s->sparse == NULL) {
+    for (size_t i = 0; i < s->len; ++i)
+      if (s->states[i] == state)
+        return true;
+    return false;
+  }
+  return state < s->capacity && s->sparse[state] < s->len &&
+         s->states[s->sparse[state]] == state;
+}
+
+/* push a state into the container, if it is not there yet */
 void push_state(States *s, State state) {
+  if (have_state(s, state))
+    return;
+  if (s->sparse == NULL && s->len < STATES_LIST_MAX) {
+    s->states[s->len++] = state;
+    return;
+  }
+  reserve_states(s, (size_t)state + 1);
+  s->sparse[state] = s->len;
   s->states[s->len] = state;
   ++(s->len);
 }
 
+/* remove all states */
+void clear_states(States *s) { s->len = 0; }
+
 /* if the states is empty */
 bool states_is_empty(States *s) { return s->len == 0; }
 
-/* if the container has the state */
-bool have_state(States *s, State state) {
-  for (size_t i = 0; i < s->len; ++i)
-    if (s->states[i] == state)
-      return true;
-  return false;
+static int compare_states(const void *a, const void *b) {
+  State x = *(const State *)a;
+  State y = *(const State *)b;
+  return (x > y) - (x < y);
 }
 
-/* if two containers have the same state, return the state */
+/* sort the states in ascending order */
+void sort_states(States *s) {
+  qsort(s->states, s->len, sizeof(State), compare_states);
+  for (size_t i = 0; s->sparse != NULL && i < s->len; ++i)
+    s->sparse[s->states[i]] = i;
+}
+
+/* if two containers have the same state, return the first one in s1 */
 State get_shared_states(States *s1, States *s2) {
   for (size_t i = 0; i < s1->len; ++i) {
-    for (size_t j = 0; j < s2->len; ++j) {
-      if (s1->states[i] == s2->states[j])
-        return s1->states[i];
-    }
+    if (have_state(s2, s1->states[i]))
+      return s1->states[i];
   }
   return 0;
 }
@@ -53,11 +134,11 @@ void print_states(States *s) {
   if (s->len == 0) {
     printf("]\n");
   } else if (s->len == 1) {
-    printf("%hu]\n", s->states[0]);
+    printf("%u]\n", s->states[0]);
   } else {
     for (size_t i = 0; i < s->len - 1; ++i) {
-      printf("%hu, ", s->states[i]);
+      printf("%u, ", s->states[i]);
     }
-    printf("%hu]\n", s->states[s->len - 1]);
+    printf("%u]\n", s->states[s->len - 1]);
   }
 }
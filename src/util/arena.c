@@ -0,0 +1,75 @@
+/*
+ * bump allocator: memory is cut from big blocks in order, and only freed all
+ * at once with the arena. what is built together and dies together, like the
+ * nodes of the ASTs and the edges of an NFA, is allocated from one arena.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#define ARENA_BLOCK_SIZE 4096
+#define ARENA_ALIGN (_Alignof(max_align_t))
+
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t used;
+  size_t size;
+  max_align_t data[];
+} ArenaBlock;
+
+typedef struct Arena {
+  ArenaBlock *blocks; /* the block allocated from first, newest first */
+} Arena;
+
+/* create an empty arena */
+Arena *new_arena() {
+  Arena *arena = (Arena *)malloc(sizeof(Arena));
+  arena->blocks = NULL;
+  return arena;
+}
+
+/* allocate `size` bytes, aligned for any type, which live until the arena */
+void *arena_alloc(Arena *arena, size_t size) {
+  size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+  ArenaBlock *block = arena->blocks;
+  if (block == NULL || block->used + size > block->size) {
+    /* blocks double, so that big builds need few of them */
+    size_t block_size = block == NULL ? ARENA_BLOCK_SIZE : block->size * 2;
+    if (block_size < size)
+      block_size = size;
+    block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + block_size);
+    block->next = arena->blocks;
+    block->used = 0;
+    block->size = block_size;
+    arena->blocks = block;
+  }
+  void *p = (char *)block->data + block->used;
+  block->used += size;
+  return p;
+}
+
+/* free everything allocated from an arena, keeping its largest block */
+void clear_arena(Arena *arena) {
+  ArenaBlock *block = arena->blocks;
+  if (block == NULL)
+    return;
+  ArenaBlock *older = block->next;
+  while (older != NULL) {
+    ArenaBlock *next = older->next;
+    free(older);
+    older = next;
+  }
+  block->next = NULL;
+  block->used = 0;
+}
+
+/* free an arena and everything allocated from it */
+void free_arena(Arena *arena) {
+  ArenaBlock *block = arena->blocks;
+  while (block != NULL) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  free(arena);
+}
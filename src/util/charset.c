@@ -0,0 +1,111 @@
+/*
+ * set of chars as a 256-bit bitmap, membership is one bit test
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct CharSet {
+  unsigned char bits[32];
+} CharSet;
+
+/* create an empty set */
+CharSet *new_charset() {
+  CharSet *set = (CharSet *)calloc(1, sizeof(CharSet));
+  return set;
+}
+
+/* create an empty set in an arena */
+CharSet *new_charset_in(Arena *arena) {
+  CharSet *set = (CharSet *)arena_alloc(arena, sizeof(CharSet));
+  memset(set, 0, sizeof(CharSet));
+  return set;
+}
+
+/* add a char to the set */
+void add_char(CharSet *set, char c) {
+  unsigned char u = (unsigned char)c;
+  set->bits[u >> 3] |= 1 << (u & 7);
+}
+
+/* add all chars in [from, to] to the set */
+void add_range(CharSet *set, char from, char to) {
+  for (int c = (unsigned char)from; c <= (unsigned char)to; ++c)
+    add_char(set, (char)c);
+}
+
+/* keep the chars not in the set, and only them */
+void negate_charset(CharSet *set) {
+  for (size_t i = 0; i < sizeof(set->bits); ++i)
+    set->bits[i] = ~set->bits[i];
+}
+
+/* if the set has the char */
+static inline bool have_char(CharSet *set, char c) {
+  unsigned char u = (unsigned char)c;
+  return set->bits[u >> 3] & (1 << (u & 7));
+}
+
+/* if two sets have the same chars */
+bool equal_charset(CharSet *a, CharSet *b) {
+  return memcmp(a->bits, b->bits, sizeof(a->bits)) == 0;
+}
+
+/* hash of the chars of the set */
+size_t hash_charset(CharSet *set) {
+  size_t h = 0;
+  for (size_t i = 0; i < sizeof(set->bits); ++i)
+    h = h * 31 + set->bits[i];
+  return h;
+}
+
+/* add the chars of `other` to the set */
+void union_charset(CharSet *set, CharSet *other) {
+  for (size_t i = 0; i < sizeof(set->bits); ++i)
+    set->bits[i] |= other->bits[i];
+}
+
+/* number of chars in the set */
+unsigned int count_charset(CharSet *set) {
+  unsigned int count = 0;
+  for (size_t i = 0; i < sizeof(set->bits); ++i)
+    count += __builtin_popcount(set->bits[i]);
+  return count;
+}
+
+/*
+ * the chars a match can start with, to skip positions where no match starts:
+ * a lone char is searched with memchr, other sets with one bit test per char
+ */
+typedef struct Prefilter {
+  CharSet set;
+  unsigned int count; /* chars in the set */
+  char single;        /* the char of a set of one */
+} Prefilter;
+
+/* make a prefilter for matches starting with a char in the set */
+void set_prefilter(Prefilter *prefilter, CharSet *set) {
+  prefilter->set = *set;
+  prefilter->count = count_charset(set);
+  prefilter->single = 0;
+  for (int c = 0; c < 256 && prefilter->count == 1; ++c)
+    if (have_char(set, (char)c)) {
+      prefilter->single = (char)c;
+      break;
+    }
+}
+
+/* the first position in input[from, len) where a match can start, or len */
+size_t prefilter_skip(Prefilter *prefilter, char *input, size_t from,
+                      size_t len) {
+  if (prefilter->count == 256 || from >= len)
+    return from;
+  if (prefilter->count == 1) {
+    char *found = (char *)memchr(input + from, prefilter->single, len - from);
+    return found == NULL ? len : (size_t)(found - input);
+  }
+  while (from < len && !have_char(&prefilter->set, input[from]))
+    ++from;
+  return from;
+}
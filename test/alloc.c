@@ -0,0 +1,109 @@
+/*
+ * count the allocations of the library, which is compiled with this file:
+ * once the automata and contexts are made, scanning allocates nothing
+ */
+#include <stdlib.h>
+
+static size_t g_allocations = 0;
+
+static void *counting_malloc(size_t size) {
+  ++g_allocations;
+  return malloc(size);
+}
+
+static void *counting_calloc(size_t count, size_t size) {
+  ++g_allocations;
+  return calloc(count, size);
+}
+
+static void *counting_realloc(void *p, size_t size) {
+  ++g_allocations;
+  return realloc(p, size);
+}
+
+#define malloc(size) counting_malloc(size)
+#define calloc(count, size) counting_calloc(count, size)
+#define realloc(p, size) counting_realloc(p, size)
+
+#include "../src/scanner.c"
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+char *patterns[] = {"if|else|while", "[a-zA-Z_][a-zA-Z0-9_]*", "[0-9]+",
+                    "[ \\t\\n]+", "==|=|<|>|\\+|\\-|\\*|/", "\\(|\\)|{|}|;", "."};
+#define PATTERNS_LEN (sizeof(patterns) / sizeof(char *))
+
+char *input = "if (a < b) { count = count + 12; } else { x = y * 3; }\n"
+              "while (x1 == 42) { y = y + 1; } @@ 0123 abc_def\n";
+
+/* drop the bit-parallel matcher, to step through sets of states */
+NFA *without_bits(NFA *nfa) {
+  free(nfa->bits);
+  nfa->bits = NULL;
+  return nfa;
+}
+
+size_t scan(Scanner *scanner) {
+  size_t tokens = 0;
+  scanner_set_buffer(scanner, input, strlen(input));
+  while (!scanner_is_done(scanner)) {
+    scanner_match(scanner);
+    ++tokens;
+  }
+  return tokens;
+}
+
+void scanners() {
+  Engine engines[] = {ENGINE_NFA, ENGINE_DFA, ENGINE_LAZY_DFA};
+  for (size_t e = 0; e < sizeof(engines) / sizeof(Engine); ++e) {
+    Automaton *automaton = compile(patterns, PATTERNS_LEN, engines[e]);
+    without_bits(automaton->nfa);
+    Scanner *scanner = new_scanner(automaton);
+    /* the first scan grows yytext and fills the lazy DFA */
+    size_t tokens = scan(scanner);
+    g_allocations = 0;
+    assert(scan(scanner) == tokens);
+    assert(g_allocations == 0);
+    free_scanner(scanner);
+    free_automaton(automaton);
+  }
+}
+
+void nfa_matching() {
+  NFA *nfa = without_bits(build_many(patterns, PATTERNS_LEN));
+  NFA *one = without_bits(build("fo(o|ba*r)*baz"));
+  MatchContext *context = new_match_context(nfa);
+  /* a context made for one NFA grows once for a larger one */
+  match_full_in(context, one, "foobarbaz");
+
+  g_allocations = 0;
+  assert(match_full_in(context, one, "foobarbaz"));
+  assert(!match_full_in(context, one, "foobaz!"));
+  Span span = match_span_in(context, nfa, input, strlen(input));
+  assert(span.start == 0 && span.len == 2 && span.pattern == 0);
+  assert(g_allocations == 0);
+
+  /* yy_match keeps its context and yytext between scans */
+  for (int pass = 0; pass < 2; ++pass) {
+    g_allocations = 0;
+    g_buffer = g_buffer_ptr = input;
+    g_buflen = strlen(input);
+    while (g_buffer_ptr < g_buffer + g_buflen)
+      yy_match(nfa);
+  }
+  assert(g_allocations == 0);
+
+  free_match_context(context);
+  free_nfa(nfa);
+  free_nfa(one);
+}
+
+int main(int argc, char *argv[]) {
+  scanners();
+  nfa_matching();
+
+  printf("All tests in alloc.c pass!\n");
+  return EXIT_SUCCESS;
+}
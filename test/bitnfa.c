@@ -0,0 +1,93 @@
+#include "../src/match.c"
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+char *inputs[] = {"",       "a",         "abb",      "aabb",   "babb",
+                  "fobaz",  "fobaaarbaz", "foobaz",   "fobrba", "114514",
+                  "x+",     "a+b",        "+",        "\n",     "zzabbzz",
+                  "fofobaz", "0a1b2c",    "ab ab abb"};
+#define INPUTS_LEN (sizeof(inputs) / sizeof(char *))
+
+/* the same NFA without its bit-parallel matcher */
+NFA *build_slow(char *pattern) {
+  NFA *nfa = build(pattern);
+  free(nfa->bits);
+  nfa->bits = NULL;
+  return nfa;
+}
+
+void same_as_nfa() {
+  char *patterns[] = {"fo(o|ba*r)*baz", "(a|b)*abb", "[0-9]+", ".\\+",
+                      "a*",             "(ab|b)*",   "[^a]b", "\\n|x+"};
+  for (size_t p = 0; p < sizeof(patterns) / sizeof(char *); ++p) {
+    NFA *fast = build(patterns[p]);
+    NFA *slow = build_slow(patterns[p]);
+    assert(fast->bits != NULL);
+    for (size_t i = 0; i < INPUTS_LEN; ++i) {
+      assert(match_full(fast, inputs[i]) == match_full(slow, inputs[i]));
+      IdxType len = strlen(inputs[i]);
+      Span a = match_span(fast, inputs[i], len);
+      Span b = match_span(slow, inputs[i], len);
+      assert(a.start == b.start && a.len == b.len && a.pattern == b.pattern);
+    }
+    free_nfa(fast);
+    free_nfa(slow);
+  }
+}
+
+void many_patterns() {
+  char *patterns[] = {"ab", "a[a-z]*", "[0-9]+", "abb"};
+  NFA *nfa = build_many(patterns, 4);
+  assert(nfa->bits != NULL);
+  assert(nfa->bits->positions_count == 8); /* [0-9]+ is one position */
+
+  /* the first pattern wins for the same text */
+  Span span = match_span(nfa, "  ab", 4);
+  assert(span.start == 2 && span.len == 2 && span.pattern == 0);
+  span = match_span(nfa, "  abb", 5);
+  assert(span.start == 2 && span.len == 3 && span.pattern == 1);
+  span = match_span(nfa, "42", 2);
+  assert(span.start == 0 && span.len == 2 && span.pattern == 2);
+  free_nfa(nfa);
+}
+
+void too_large() {
+  char pattern[80];
+  memset(pattern, 'a', 65);
+  pattern[65] = '\0';
+  NFA *nfa = build(pattern);
+  assert(nfa->bits == NULL);
+  assert(match_full(nfa, pattern));
+  free_nfa(nfa);
+
+  pattern[64] = '\0';
+  nfa = build(pattern);
+  assert(nfa->bits != NULL);
+  assert(match_full(nfa, pattern));
+  pattern[63] = '\0';
+  assert(!match_full(nfa, pattern));
+  free_nfa(nfa);
+}
+
+/* pushing an edge by hand drops the matcher, which doesn't know it */
+void pushed_edges() {
+  NFA *nfa = build("ab");
+  assert(nfa->bits != NULL);
+  push_edge(nfa, new_edge(nfa->arena, new_literal_label(nfa->arena, 'c'), 1, 1));
+  assert(nfa->bits == NULL);
+  assert(match_full(nfa, "acb"));
+  free_nfa(nfa);
+}
+
+int main(int argc, char *argv[]) {
+  same_as_nfa();
+  many_patterns();
+  too_large();
+  pushed_edges();
+
+  printf("All tests in bitnfa.c pass!\n");
+  return EXIT_SUCCESS;
+}
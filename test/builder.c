@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 void tokenize() {
   char *pattern = "fo(o|ba*r)*baz";
@@ -28,14 +29,14 @@ void tokenize() {
     assert(token->type == types[i]);
     ++i;
   }
-  free(token);
   free(lexer);
 }
 
 void test_ast() {
   char *pattern = "fo(o|ba*r)*baz";
+  Arena *a = new_arena();
   Lexer *lexer = new_lexer(pattern);
-  Parser *parser = new_parser(lexer);
+  Parser *parser = new_parser(lexer, a);
   Ast *ast = parse(parser);
 
   /*
@@ -64,59 +65,83 @@ void test_ast() {
   // clang-format off
   assert(equal_ast(
       ast,
-      new_ast_and(
-          new_ast_and(
-              new_ast_and(
-                  new_ast_and(
-                      new_ast_and(
-                          new_ast_literal('f'),
-                          new_ast_literal('o')),
-                      new_ast_repeat(
-                          new_ast_surround(
-                              new_ast_or(
-                                  new_ast_literal('o'),
-                                  new_ast_and(
-                                      new_ast_and(
-                                          new_ast_literal('b'),
-                                          new_ast_repeat(
-                                              new_ast_literal('a'))), 
-                                      new_ast_literal('r')))))),
-              new_ast_literal('b')),
-          new_ast_literal('a')),
-      new_ast_literal('z'))));
+      new_ast_and(a, 
+          new_ast_and(a, 
+              new_ast_and(a, 
+                  new_ast_and(a, 
+                      new_ast_and(a, 
+                          new_ast_literal(a, 'f'),
+                          new_ast_literal(a, 'o')),
+                      new_ast_repeat(a, 
+                          new_ast_surround(a, 
+                              new_ast_or(a, 
+                                  new_ast_literal(a, 'o'),
+                                  new_ast_and(a, 
+                                      new_ast_and(a, 
+                                          new_ast_literal(a, 'b'),
+                                          new_ast_repeat(a, 
+                                              new_ast_literal(a, 'a'))), 
+                                      new_ast_literal(a, 'r')))))),
+              new_ast_literal(a, 'b')),
+          new_ast_literal(a, 'a')),
+      new_ast_literal(a, 'z'))));
   // clang-format on
 
-  free_ast(ast);
-  if (lexer->current_token != NULL) {
-    free(lexer->current_token);
-  }
+  free_arena(a);
   free(lexer);
   free(parser);
 }
 
 void test_ast_set() {
   char *pattern = "[^0-9]";
+  Arena *a = new_arena();
   Lexer *lexer = new_lexer(pattern);
-  Parser *parser = new_parser(lexer);
+  Parser *parser = new_parser(lexer, a);
   Ast *ast = parse(parser);
 
+  /* the negation is folded into the set */
   assert(ast->type == SetNode);
-  assert(ast->data.AstSet.is_neg == true);
-  assert(ast->data.AstSet.set->size == 10);
-  assert(ast->data.AstSet.set->data[0] == '0');
-  assert(ast->data.AstSet.set->data[1] == '1');
-  assert(ast->data.AstSet.set->data[2] == '2');
-  assert(ast->data.AstSet.set->data[3] == '3');
-  assert(ast->data.AstSet.set->data[4] == '4');
-  assert(ast->data.AstSet.set->data[5] == '5');
-  assert(ast->data.AstSet.set->data[6] == '6');
-  assert(ast->data.AstSet.set->data[7] == '7');
-  assert(ast->data.AstSet.set->data[8] == '8');
-  assert(ast->data.AstSet.set->data[9] == '9');
+  CharSet *set = ast->data.AstSet.set;
+  for (char c = '0'; c <= '9'; ++c)
+    assert(!have_char(set, c));
+  assert(have_char(set, '/'));
+  assert(have_char(set, ':'));
+  assert(have_char(set, '\n'));
+  assert(have_char(set, '\0'));
+  assert(have_char(set, (char)0xff));
+  free_arena(a);
+  free(lexer);
+  free(parser);
+}
+
+void test_ast_range() {
+  char *pattern = "[a-zA-Z0-9_]";
+  Arena *a = new_arena();
+  Lexer *lexer = new_lexer(pattern);
+  Parser *parser = new_parser(lexer, a);
+  Ast *ast = parse(parser);
+
+  CharSet expected = {{0}};
+  add_range(&expected, 'a', 'z');
+  add_range(&expected, 'A', 'Z');
+  add_range(&expected, '0', '9');
+  add_char(&expected, '_');
+  assert(ast->type == AstSet);
+  assert(equal_charset(ast->data.AstSet.set, &expected));
+  free_arena(a);
+  free(lexer);
+  free(parser);
+
+  /* ranges reaching the last char stop there */
+  CharSet *set = new_charset();
+  add_range(set, '~', (char)0xff);
+  assert(have_char(set, 0x7f) && have_char(set, (char)0xff));
+  assert(!have_char(set, '}'));
+  free(set);
 }
 
 void test_nfa() {
-  NFA *nfa = build("fo(o|ba*r)*baz");
+  NFA *nfa = build_with("fo(o|ba*r)*baz", THOMPSON);
   /* print_edges(nfa); */
   // clang-format off
   /*
@@ -134,11 +159,97 @@ void test_nfa() {
   free_nfa(nfa);
 }
 
+void test_glushkov_nfa() {
+  NFA *nfa = build_with("fo(o|ba*r)*baz", GLUSHKOV);
+  /* a start state and one state per char, without ε-edges */
+  assert(nfa->states_count == 10);
+  assert(nfa->epsilon_offsets[nfa->states_count] == 0);
+  assert(nfa->target_states->len == 1);
+  assert(nfa->target_states->states[0] == 9);
+  free_nfa(nfa);
+
+  /* the start state accepts a pattern matching "" */
+  char *patterns[] = {"ab", "a*", "b"};
+  nfa = build_many_with(patterns, 3, GLUSHKOV);
+  assert(nfa->epsilon_offsets[nfa->states_count] == 0);
+  assert(have_state(nfa->target_states, 0));
+  assert(nfa->target_states->len == 4);
+  assert(nfa->target_patterns[0] == 0);
+  assert(nfa->target_patterns[1] == 1);
+  assert(nfa->target_patterns[2] == 1);
+  assert(nfa->target_patterns[3] == 2);
+  free_nfa(nfa);
+}
+
+/* simplify `pattern` and `expected` together, and if they are the same node */
+bool simplified_same(char *pattern, char *expected) {
+  Arena *parsed = new_arena(), *arena = new_arena();
+  Ast *asts[] = {parse_pattern(parsed, pattern),
+                 parse_pattern(parsed, expected)};
+  simplify_asts(arena, asts, 2, NULL);
+  bool same = asts[0] == asts[1];
+  free_arena(parsed);
+  free_arena(arena);
+  return same;
+}
+
+void test_simplify() {
+  assert(simplified_same("a|a", "a"));
+  assert(simplified_same("((a)(b))", "ab"));
+  assert(simplified_same("(x*)*", "x*"));
+  assert(simplified_same("(x+)*", "x*"));
+  assert(simplified_same("(x?)+", "x*"));
+  assert(simplified_same("a|b|[c-e]|fg", "[a-e]|fg"));
+  assert(simplified_same("ab|ac", "a[bc]"));
+  assert(simplified_same("if|ifdef|ifndef|else", "if(def|ndef)?|else"));
+  assert(!simplified_same("a*", "a+"));
+  assert(!simplified_same("(x{2})*", "x*"));
+
+  /* equal subtrees are one node */
+  Arena *parsed = new_arena(), *arena = new_arena();
+  Ast *asts[] = {parse_pattern(parsed, "(ab|cd)*x"),
+                 parse_pattern(parsed, "y(ab|cd)*x")};
+  AstStats stats;
+  simplify_asts(arena, asts, 2, &stats);
+  assert(asts[1]->data.AstAnd.r2 == asts[0]);
+  assert(stats.before == 24);
+  assert(stats.after == 12);
+  free_arena(parsed);
+  free_arena(arena);
+
+  NFA *nfa = build("a|a|a");
+  assert(nfa->ast_stats.before == 5 && nfa->ast_stats.after == 1);
+  assert(nfa->states_count == 2);
+  free_nfa(nfa);
+}
+
+void test_arena() {
+  Arena *arena = new_arena();
+  char *small = (char *)arena_alloc(arena, 3);
+  double *aligned = (double *)arena_alloc(arena, sizeof(double));
+  assert((size_t)aligned % ARENA_ALIGN == 0);
+  assert((char *)aligned >= small + 3);
+  /* larger than a block */
+  char *large = (char *)arena_alloc(arena, 3 * ARENA_BLOCK_SIZE);
+  memset(large, 'x', 3 * ARENA_BLOCK_SIZE);
+  assert(arena->blocks->size >= 3 * ARENA_BLOCK_SIZE);
+
+  /* the largest block is kept and used again */
+  clear_arena(arena);
+  assert(arena->blocks->next == NULL && arena->blocks->used == 0);
+  assert(arena_alloc(arena, 8) == (void *)large);
+  free_arena(arena);
+}
+
 int main() {
   tokenize();
   test_ast();
   test_ast_set();
+  test_ast_range();
   test_nfa();
+  test_glushkov_nfa();
+  test_simplify();
+  test_arena();
 
   printf("All tests in builder.c pass!\n");
   return EXIT_SUCCESS;
@@ -0,0 +1,88 @@
+#include "../src/match.c"
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+char *patterns[] = {"if|else", "[a-z_][a-z0-9_]*", "[0-9]+", "[ \\n]+",
+                    "fo(o|ba*r)*baz", "==|="};
+#define PATTERNS_LEN (sizeof(patterns) / sizeof(char *))
+
+char *input = "if x1 == 42\nelse fobrbaaarbaz = iffy @ fobaz";
+
+/* tokens of the input, one `start length pattern` line each */
+void expected_tokens(char *out) {
+  NFA *nfa = build_many(patterns, PATTERNS_LEN);
+  DFA *dfa = nfa2dfa(nfa);
+  dfa_minimize(dfa);
+  IdxType len = strlen(input);
+  IdxType position = 0;
+  out[0] = '\0';
+  for (;;) {
+    Span span = dfa_match_span(dfa, input + position, len - position);
+    if (span.pattern < 0)
+      break;
+    sprintf(out + strlen(out), "%lu %lu %d\n", position + span.start,
+            span.len, span.pattern);
+    position += span.start + span.len;
+  }
+  free_dfa(dfa);
+  free_nfa(nfa);
+}
+
+char *driver = "#include <stdio.h>\n"
+               "#include <string.h>\n"
+               "int main(int argc, char *argv[]) {\n"
+               "  unsigned long len = strlen(argv[1]), position = 0;\n"
+               "  unsigned long start, length;\n"
+               "  int pattern;\n"
+               "  while ((pattern = tk_scan(argv[1] + position,\n"
+               "                            len - position, &start,\n"
+               "                            &length)) >= 0) {\n"
+               "    printf(\"%lu %lu %d\\n\", position + start, length,\n"
+               "           pattern);\n"
+               "    position += start + length;\n"
+               "  }\n"
+               "  return 0;\n"
+               "}\n";
+
+/* generate, compile and run a scanner, put what it prints in `out` */
+void run_generated(CodeStyle style, char *out) {
+  char source[] = "/tmp/re_test_codegen_XXXXXX.c";
+  close(mkstemps(source, 2));
+  FILE *file = fopen(source, "w");
+  generate_scanner(patterns, PATTERNS_LEN, "tk", style, file);
+  fputs(driver, file);
+  fclose(file);
+
+  char command[512];
+  char binary[] = "/tmp/re_test_codegen_bin_XXXXXX";
+  close(mkstemp(binary));
+  sprintf(command, "gcc -Wall -Werror -O2 %s -o %s", source, binary);
+  assert(system(command) == 0);
+  sprintf(command, "%s '%s'", binary, input);
+  FILE *output = popen(command, "r");
+  size_t n = fread(out, 1, 1023, output);
+  out[n] = '\0';
+  assert(pclose(output) == 0);
+  unlink(source);
+  unlink(binary);
+}
+
+void same_as_dfa() {
+  char expected[1024], got[1024];
+  expected_tokens(expected);
+  assert(strlen(expected) > 0);
+  run_generated(CODE_TABLES, got);
+  assert(strcmp(expected, got) == 0);
+  run_generated(CODE_DIRECT, got);
+  assert(strcmp(expected, got) == 0);
+}
+
+int main(int argc, char *argv[]) {
+  same_as_dfa();
+
+  printf("All tests in codegen.c pass!\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,258 @@
+#include "../src/match.c"
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void match_one_pattern() {
+  NFA *nfa = build("fo(o|ba*r)*baz");
+  DFA *dfa = nfa2dfa(nfa);
+
+  assert(dfa_match_full(dfa, "fobaz"));
+  assert(dfa_match_full(dfa, "fobrbaz"));
+  assert(dfa_match_full(dfa, "fobaaaarbaz"));
+  assert(dfa_match_full(dfa, "fobrbrbrbrbrbaz"));
+  assert(!dfa_match_full(dfa, "fobrbrbrbrbrba"));
+  assert(!dfa_match_full(dfa, ""));
+
+  free_dfa(dfa);
+  free_nfa(nfa);
+}
+
+void dead_state() {
+  NFA *nfa = build("ab");
+  DFA *dfa = nfa2dfa(nfa);
+
+  /* dead, start, after `a`, after `ab` */
+  assert(dfa->states_count == 4);
+  assert(dfa->accepts[DFA_DEAD] == -1);
+  for (int c = 0; c < ALPHABET_SIZE; ++c)
+    assert(dfa_next(dfa, DFA_DEAD, (char)c) == DFA_DEAD);
+  assert(dfa_next(dfa, dfa->start, 'b') == DFA_DEAD);
+
+  free_dfa(dfa);
+  free_nfa(nfa);
+}
+
+void classes() {
+  char *patterns[] = {"[a-z_][a-z0-9_]*", "[0-9]+", "if|else", ".", "\\n"};
+  IdxType len = sizeof(patterns) / sizeof(char *);
+  NFA *nfa = build_many(patterns, len);
+  DFA *dfa = nfa2dfa(nfa);
+
+  /* i, f, e, l, s, other lowercase and _, digits, newline, everything else */
+  assert(dfa->classes_count == 9);
+  assert(dfa->classes['a'] == dfa->classes['z']);
+  assert(dfa->classes['0'] == dfa->classes['9']);
+  assert(dfa->classes['i'] != dfa->classes['a']);
+  assert(dfa->classes['\n'] != dfa->classes['@']);
+  assert(dfa->classes['@'] == dfa->classes[0xff]);
+
+  free_dfa(dfa);
+  free_nfa(nfa);
+}
+
+void match_multiple_patterns() {
+  char *patterns[] = {"foo", "foooo", "fo*b"};
+  IdxType len = sizeof(patterns) / sizeof(char *);
+  NFA *nfa = build_many(patterns, len);
+  DFA *dfa = nfa2dfa(nfa);
+
+  assert(dfa_match_full(dfa, "foo"));
+  assert(dfa_match_full(dfa, "foooo"));
+  assert(dfa_match_full(dfa, "fb"));
+  assert(dfa_match_full(dfa, "foooooob"));
+  assert(!dfa_match_full(dfa, "fo"));
+  assert(!dfa_match_full(dfa, "fooo"));
+  assert(!dfa_match_full(dfa, "fbi"));
+
+  free_dfa(dfa);
+  free_nfa(nfa);
+}
+
+void match_partitially() {
+  char *patterns[] = {"foo", "foooo", "fo*b"};
+  IdxType len = sizeof(patterns) / sizeof(char *);
+  NFA *nfa = build_many(patterns, len);
+  DFA *dfa = nfa2dfa(nfa);
+
+  char text[10];
+
+  assert(dfa_match(dfa, "bfooooob", text) == 7);
+  assert(strcmp(text, "fooooob") == 0);
+
+  assert(dfa_match(dfa, "bfoooa", text) == 3);
+  assert(strcmp(text, "foo") == 0);
+
+  assert(dfa_match(dfa, "bfoooooa", text) == 5);
+  assert(strcmp(text, "foooo") == 0);
+
+  free_dfa(dfa);
+  free_nfa(nfa);
+}
+
+void yy() {
+  char *patterns[] = {"foo", "foooo", "fo*b"};
+  IdxType len = sizeof(patterns) / sizeof(char *);
+  NFA *nfa = build_many(patterns, len);
+  DFA *dfa = nfa2dfa(nfa);
+
+  g_buffer = "fooobaz";
+  g_buflen = 7;
+  g_buffer_ptr = g_buffer;
+
+  assert(dfa_yy_match(dfa) == 2);
+  assert(*g_buffer_ptr == 'a');
+
+  /* the first pattern wins when several match the same text */
+  g_buffer = "foooo";
+  g_buflen = 5;
+  g_buffer_ptr = g_buffer;
+  assert(dfa_yy_match(dfa) == 1);
+  assert(strcmp(yytext, "foooo") == 0);
+
+  free_dfa(dfa);
+  free_nfa(nfa);
+}
+
+/* the DFA must agree with the NFA it is built from */
+void same_as_nfa() {
+  char *patterns[] = {"[a-z_][a-z0-9_]*", "[0-9]+", "if|else", "\\n", ".",
+                      "fo(o|ba*r)*baz"};
+  IdxType len = sizeof(patterns) / sizeof(char *);
+  NFA *nfa = build_many(patterns, len);
+  DFA *dfa = nfa2dfa(nfa);
+
+  char *inputs[] = {"if",    "else",  "iffy",         "x1_",   "0123",
+                    "01a",   "\n",    "fobrbaaarbaz", "fobaz", "",
+                    "@",     "a b",   "if else 42",   "_",     "fo"};
+  char text[32], dfa_text[32];
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(char *); ++i) {
+    assert(match_full(nfa, inputs[i]) == dfa_match_full(dfa, inputs[i]));
+    assert(match(nfa, inputs[i], text) == dfa_match(dfa, inputs[i], dfa_text));
+    assert(strcmp(text, dfa_text) == 0);
+  }
+
+  g_buffer = "if iffy 42\nfobaz";
+  g_buflen = strlen(g_buffer);
+  g_buffer_ptr = g_buffer;
+  while (g_buffer_ptr < g_buffer + g_buflen) {
+    char *start = g_buffer_ptr;
+    int expected = yy_match(nfa);
+    char expected_text[32];
+    strcpy(expected_text, yytext);
+    char *expected_end = g_buffer_ptr;
+
+    g_buffer_ptr = start;
+    assert(dfa_yy_match(dfa) == expected);
+    assert(strcmp(yytext, expected_text) == 0);
+    assert(g_buffer_ptr == expected_end);
+  }
+
+  free_dfa(dfa);
+  free_nfa(nfa);
+}
+
+void minimize() {
+  NFA *nfa = build("(a|b)*abb");
+  DFA *dfa = nfa2dfa(nfa);
+
+  /* dead state plus A, B, C, D, E of the dragon book, B and D merge */
+  MinimizeReport report = dfa_minimize(dfa);
+  assert(report.states_before == 6);
+  assert(report.states_after == 5);
+  assert(dfa->states_count == 5);
+  assert(dfa->accepts[DFA_DEAD] == -1);
+  assert(dfa_next(dfa, dfa->start, 'c') == DFA_DEAD);
+
+  assert(dfa_match_full(dfa, "abb"));
+  assert(dfa_match_full(dfa, "babaabb"));
+  assert(!dfa_match_full(dfa, "abba"));
+  assert(!dfa_match_full(dfa, "ab"));
+
+  /* minimizing a minimal DFA changes nothing */
+  report = dfa_minimize(dfa);
+  assert(report.states_before == report.states_after);
+
+  free_dfa(dfa);
+  free_nfa(nfa);
+}
+
+void minimize_keeps_patterns_apart() {
+  char *patterns[] = {"a", "b", "c|d", "[cd]x*"};
+  IdxType len = sizeof(patterns) / sizeof(char *);
+  NFA *nfa = build_many(patterns, len);
+  DFA *dfa = nfa2dfa(nfa);
+  dfa_minimize(dfa);
+
+  /* dead, start, `a`, `b`, `c|d` and `[cd]x*` after one char, `[cd]x+` */
+  assert(dfa->states_count == 6);
+
+  g_buffer = "abdxxc";
+  g_buflen = 6;
+  g_buffer_ptr = g_buffer;
+  assert(dfa_yy_match(dfa) == 0);
+  assert(dfa_yy_match(dfa) == 1);
+  assert(dfa_yy_match(dfa) == 3);
+  assert(strcmp(yytext, "dxx") == 0);
+  assert(dfa_yy_match(dfa) == 2);
+
+  free_dfa(dfa);
+  free_nfa(nfa);
+}
+
+bool build_and_match(char *pattern, char *input) {
+  NFA *nfa = build(pattern);
+  DFA *dfa = nfa2dfa(nfa);
+  dfa_minimize(dfa);
+  bool result = dfa_match_full(dfa, input);
+  free_dfa(dfa);
+  free_nfa(nfa);
+  return result;
+}
+
+void extended_rules() {
+  /* or */
+  assert(build_and_match("re|lers", "re"));
+  assert(build_and_match("re|lers", "lers"));
+  /* dot */
+  assert(build_and_match("f.o", "foo"));
+  assert(build_and_match("f.+o", "farstdhneio"));
+  assert(!build_and_match("f.+o", "fo"));
+  assert(!build_and_match("f.+o", "farstdhneiob"));
+  /* range */
+  assert(build_and_match("[0-9]", "5"));
+  assert(build_and_match("[0-9a-z]", "b"));
+  assert(build_and_match("[^0-9]", "b"));
+  assert(build_and_match("[^0-9a-z]", "B"));
+  assert(build_and_match("[0-9]+", "114514"));
+  /* set */
+  assert(build_and_match("[abc]", "b"));
+  assert(!build_and_match("[abc]", "d"));
+  assert(build_and_match("[^abc]", "d"));
+  assert(!build_and_match("[^abc]", "b"));
+  /* back slash */
+  assert(build_and_match(".\\+", "a+"));
+  assert(build_and_match(".\\*", "b*"));
+  assert(build_and_match("[a-z\\[\\]]+", "a]b[c]"));
+  assert(build_and_match(".\\.", "c."));
+  assert(!build_and_match(".\\+", "abc"));
+  assert(build_and_match("\\n", "\n"));
+}
+
+int main(int argc, char *argv[]) {
+  match_one_pattern();
+  dead_state();
+  classes();
+  match_multiple_patterns();
+  match_partitially();
+  yy();
+  same_as_nfa();
+  minimize();
+  minimize_keeps_patterns_apart();
+  extended_rules();
+
+  printf("All tests in dfa.c pass!\n");
+  return EXIT_SUCCESS;
+}
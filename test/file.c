@@ -0,0 +1,108 @@
+#include "../src/file.c"
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+char *patterns[] = {"if|else|while", "[a-zA-Z_][a-zA-Z0-9_]*", "[0-9]+",
+                    "[ \\t\\n]+", "==|=|<|>|\\+|\\-|\\*|/", "\\(|\\)|{|}|;"};
+#define PATTERNS_LEN (sizeof(patterns) / sizeof(char *))
+
+typedef struct Tokens {
+  char text[256]; /* tokens joined with '|' */
+  size_t len;
+} Tokens;
+
+void collect(char *buffer, Span span, void *data) {
+  Tokens *tokens = (Tokens *)data;
+  /* skip spaces, and what doesn't fit */
+  if (span.pattern == 3 || tokens->len + span.len + 2 > sizeof(tokens->text))
+    return;
+  memcpy(tokens->text + tokens->len, buffer + span.start, span.len);
+  tokens->len += span.len;
+  tokens->text[tokens->len++] = '|';
+  tokens->text[tokens->len] = '\0';
+}
+
+/* write `content` to a temporary file, return its path */
+char *temp_file(char *content) {
+  static char path[] = "/tmp/re_test_file_XXXXXX";
+  strcpy(path + strlen(path) - 6, "XXXXXX");
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  assert(write(fd, content, strlen(content)) == (ssize_t)strlen(content));
+  close(fd);
+  return path;
+}
+
+void scan_tokens() {
+  Automaton *automaton = compile(patterns, PATTERNS_LEN, ENGINE_DFA);
+  char *path = temp_file("while (x1 == 42) {\n  y = y + 1;\n}\n");
+  Tokens tokens = {"", 0};
+  assert(scan_file(path, automaton, collect, &tokens) == 0);
+  assert(strcmp(tokens.text, "while|(|x1|==|42|)|{|y|=|y|+|1|;|}|") == 0);
+  unlink(path);
+  free_automaton(automaton);
+}
+
+void empty_file() {
+  Automaton *automaton = compile(patterns, PATTERNS_LEN, ENGINE_DFA);
+  char *path = temp_file("");
+  Tokens tokens = {"", 0};
+  assert(scan_file(path, automaton, collect, &tokens) == 0);
+  assert(tokens.len == 0);
+  unlink(path);
+  free_automaton(automaton);
+}
+
+/* files which can't be mapped are read as a stream */
+void unmapped_files() {
+  Automaton *automaton = compile(patterns, PATTERNS_LEN, ENGINE_DFA);
+  Tokens tokens = {"", 0};
+  assert(scan_file("/proc/self/status", automaton, collect, &tokens) == 0);
+  assert(strncmp(tokens.text, "Name|", 5) == 0);
+
+  char path[] = "/tmp/re_test_fifo_XXXXXX";
+  assert(mkdtemp(path) != NULL);
+  char fifo[64];
+  sprintf(fifo, "%s/fifo", path);
+  assert(mkfifo(fifo, 0600) == 0);
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    int fd = open(fifo, O_WRONLY);
+    char *content = "x = 1;\nwhile (x < 10) x = x * 2;\n";
+    ssize_t len = strlen(content);
+    _exit(write(fd, content, len) == len ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  tokens = (Tokens){"", 0};
+  assert(scan_file(fifo, automaton, collect, &tokens) == 0);
+  assert(strcmp(tokens.text, "x|=|1|;|while|(|x|<|10|)|x|=|x|*|2|;|") == 0);
+  int status;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  unlink(fifo);
+  rmdir(path);
+  free_automaton(automaton);
+}
+
+void missing_file() {
+  Automaton *automaton = compile(patterns, PATTERNS_LEN, ENGINE_DFA);
+  Tokens tokens = {"", 0};
+  assert(scan_file("/nonexistent/re_test", automaton, collect, &tokens) == -1);
+  assert(errno == ENOENT);
+  free_automaton(automaton);
+}
+
+int main(int argc, char *argv[]) {
+  scan_tokens();
+  empty_file();
+  unmapped_files();
+  missing_file();
+
+  printf("All tests in file.c pass!\n");
+  return EXIT_SUCCESS;
+}
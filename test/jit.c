@@ -0,0 +1,87 @@
+#include "../src/match.c"
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+char *patterns[] = {"if|else", "[a-z_][a-z0-9_]*", "[0-9]+", "[ \\n]+",
+                    "fo(o|ba*r)*baz", "==|=", "[^a-z0-9 ]"};
+#define PATTERNS_LEN (sizeof(patterns) / sizeof(char *))
+
+char *inputs[] = {"if",   "iffy",     "x1_ 42",   "  fobrbaaarbaz", "@@@",
+                  "",     "a == b",   "\xff\x80z", "fobaz9 else",   "\n\n",
+                  "zzz=", "fobrbaa"};
+#define INPUTS_LEN (sizeof(inputs) / sizeof(char *))
+
+DFA *compile_dfa() {
+  NFA *nfa = build_many(patterns, PATTERNS_LEN);
+  DFA *dfa = nfa2dfa(nfa);
+  dfa_minimize(dfa);
+  free_nfa(nfa);
+  return dfa;
+}
+
+/* the JIT and the interpreter agree, with and without native code */
+void same_as_dfa() {
+  DFA *dfa = compile_dfa();
+  JitDFA *jit = new_jit_dfa(dfa);
+#if defined(__x86_64__) && defined(__linux__)
+  assert(jit->function != NULL);
+#endif
+  for (int fallback = 0; fallback < 2; ++fallback) {
+    if (fallback)
+      jit->function = NULL;
+    for (size_t i = 0; i < INPUTS_LEN; ++i) {
+      IdxType len = strlen(inputs[i]);
+      Span a = jit_match_span(jit, inputs[i], len);
+      Span b = dfa_match_span(dfa, inputs[i], len);
+      assert(a.start == b.start && a.len == b.len && a.pattern == b.pattern);
+    }
+  }
+  free_jit_dfa(jit);
+  free_dfa(dfa);
+}
+
+/* random inputs over chars the patterns care about */
+void random_inputs() {
+  DFA *dfa = compile_dfa();
+  JitDFA *jit = new_jit_dfa(dfa);
+  char alphabet[] = "ifelsxo_0129 =\n@barz\xff";
+  char input[64];
+  srand(42);
+  for (int n = 0; n < 2000; ++n) {
+    IdxType len = rand() % sizeof(input);
+    for (IdxType i = 0; i < len; ++i)
+      input[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+    Span a = jit_match_span(jit, input, len);
+    Span b = dfa_match_span(dfa, input, len);
+    assert(a.start == b.start && a.len == b.len && a.pattern == b.pattern);
+  }
+  free_jit_dfa(jit);
+  free_dfa(dfa);
+}
+
+void yy() {
+  DFA *dfa = compile_dfa();
+  JitDFA *jit = new_jit_dfa(dfa);
+  g_buffer = "else if x1 == 42 fobaz";
+  g_buflen = strlen(g_buffer);
+  g_buffer_ptr = g_buffer;
+  int expected[] = {0, 3, 0, 3, 1, 3, 5, 3, 2, 3, 1};
+  for (size_t i = 0; i < sizeof(expected) / sizeof(int); ++i)
+    assert(jit_yy_match(jit) == expected[i]);
+  assert(strcmp(yytext, "fobaz") == 0);
+  assert(jit_yy_match(jit) == -1);
+  free_jit_dfa(jit);
+  free_dfa(dfa);
+}
+
+int main(int argc, char *argv[]) {
+  same_as_dfa();
+  random_inputs();
+  yy();
+
+  printf("All tests in jit.c pass!\n");
+  return EXIT_SUCCESS;
+}
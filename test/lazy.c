@@ -0,0 +1,138 @@
+#include "../src/match.c"
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LARGE_BUDGET (1 << 20)
+
+void match_one_pattern() {
+  NFA *nfa = build("fo(o|ba*r)*baz");
+  LazyDFA *lazy = new_lazy_dfa(nfa, LARGE_BUDGET);
+
+  assert(lazy_match_full(lazy, "fobaz"));
+  assert(lazy_match_full(lazy, "fobrbaz"));
+  assert(lazy_match_full(lazy, "fobaaaarbaz"));
+  assert(lazy_match_full(lazy, "fobrbrbrbrbrbaz"));
+  assert(!lazy_match_full(lazy, "fobrbrbrbrbrba"));
+
+  free_lazy_dfa(lazy);
+  free_nfa(nfa);
+}
+
+void cache_counters() {
+  NFA *nfa = build("fo(o|ba*r)*baz");
+  LazyDFA *lazy = new_lazy_dfa(nfa, LARGE_BUDGET);
+
+  /* dead and start states are cached up front */
+  assert(lazy->table->len == 2);
+  assert(lazy_match_full(lazy, "fobrbaz"));
+  assert(lazy->hits == 0);
+  assert(lazy->misses == 7);
+
+  /* the same input again only hits the cache */
+  assert(lazy_match_full(lazy, "fobrbaz"));
+  assert(lazy->hits == 7);
+  assert(lazy->misses == 7);
+  assert(lazy->flushes == 0);
+
+  free_lazy_dfa(lazy);
+  free_nfa(nfa);
+}
+
+void small_budget() {
+  char *patterns[] = {"foo", "foooo", "fo*b"};
+  IdxType len = sizeof(patterns) / sizeof(char *);
+  NFA *nfa = build_many(patterns, len);
+
+  /* room for the dead and start states and about one more */
+  LazyDFA *lazy = new_lazy_dfa(nfa, 0);
+  lazy->budget = 4 * lazy_state_size(lazy, nfa->states_count);
+
+  char text[10];
+  for (int i = 0; i < 3; ++i) {
+    assert(lazy_match(lazy, "bfooooob", text) == 7);
+    assert(strcmp(text, "fooooob") == 0);
+    assert(lazy_match(lazy, "bfoooa", text) == 3);
+    assert(strcmp(text, "foo") == 0);
+    assert(lazy_match(lazy, "bfoooooa", text) == 5);
+    assert(strcmp(text, "foooo") == 0);
+  }
+  assert(lazy->flushes > 0);
+  assert(lazy->used <= lazy->budget);
+
+  free_lazy_dfa(lazy);
+  free_nfa(nfa);
+}
+
+void yy() {
+  char *patterns[] = {"foo", "foooo", "fo*b"};
+  IdxType len = sizeof(patterns) / sizeof(char *);
+  NFA *nfa = build_many(patterns, len);
+  LazyDFA *lazy = new_lazy_dfa(nfa, LARGE_BUDGET);
+
+  g_buffer = "fooobaz";
+  g_buflen = 7;
+  g_buffer_ptr = g_buffer;
+
+  assert(lazy_yy_match(lazy) == 2);
+  assert(*g_buffer_ptr == 'a');
+
+  free_lazy_dfa(lazy);
+  free_nfa(nfa);
+}
+
+/* the lazy DFA must agree with the NFA, whatever its budget */
+void same_as_nfa() {
+  char *patterns[] = {"[a-z_][a-z0-9_]*", "[0-9]+", "if|else", "\\n", ".",
+                      "fo(o|ba*r)*baz"};
+  IdxType len = sizeof(patterns) / sizeof(char *);
+  NFA *nfa = build_many(patterns, len);
+
+  size_t budgets[] = {0, 3, 1 << 12}; /* in states */
+  char *inputs[] = {"if",  "else", "iffy",         "x1_",   "0123",
+                    "01a", "\n",   "fobrbaaarbaz", "fobaz", "",
+                    "@",   "a b",  "if else 42",   "_",     "fo"};
+  char text[32], lazy_text[32];
+  for (size_t b = 0; b < sizeof(budgets) / sizeof(size_t); ++b) {
+    LazyDFA *lazy = new_lazy_dfa(nfa, 0);
+    lazy->budget = budgets[b] * lazy_state_size(lazy, nfa->states_count);
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(char *); ++i) {
+      assert(match_full(nfa, inputs[i]) == lazy_match_full(lazy, inputs[i]));
+      assert(match(nfa, inputs[i], text) ==
+             lazy_match(lazy, inputs[i], lazy_text));
+      assert(strcmp(text, lazy_text) == 0);
+    }
+
+    g_buffer = "if iffy 42\nfobaz";
+    g_buflen = strlen(g_buffer);
+    g_buffer_ptr = g_buffer;
+    while (g_buffer_ptr < g_buffer + g_buflen) {
+      char *start = g_buffer_ptr;
+      int expected = yy_match(nfa);
+      char expected_text[32];
+      strcpy(expected_text, yytext);
+      char *expected_end = g_buffer_ptr;
+
+      g_buffer_ptr = start;
+      assert(lazy_yy_match(lazy) == expected);
+      assert(strcmp(yytext, expected_text) == 0);
+      assert(g_buffer_ptr == expected_end);
+    }
+    free_lazy_dfa(lazy);
+  }
+
+  free_nfa(nfa);
+}
+
+int main(int argc, char *argv[]) {
+  match_one_pattern();
+  cache_counters();
+  small_budget();
+  yy();
+  same_as_nfa();
+
+  printf("All tests in lazy.c pass!\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+#include "../src/scanner.c"
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Engine engines[] = {ENGINE_NFA, ENGINE_DFA, ENGINE_LAZY_DFA};
+#define ENGINES_LEN (sizeof(engines) / sizeof(Engine))
+
+bool is_literal(char *pattern) {
+  Trie *trie = new_trie();
+  Arena *arena = new_arena();
+  Ast *ast = parse_pattern(arena, pattern);
+  bool literal = trie_add_pattern(trie, ast, 0);
+  free_arena(arena);
+  free_trie(trie);
+  return literal;
+}
+
+void detect_literals() {
+  assert(is_literal("while"));
+  assert(is_literal("if|else|while"));
+  assert(is_literal("(un|re)do"));
+  assert(is_literal("\\(|\\)|\\+\\+"));
+  assert(!is_literal("a*"));
+  assert(!is_literal("ab+"));
+  assert(!is_literal("[ab]c"));
+  assert(!is_literal("f.o"));
+  /* too many strings */
+  assert(!is_literal("(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)"));
+}
+
+void trie() {
+  Trie *trie = new_trie();
+  trie_insert(trie, "do", 0);
+  trie_insert(trie, "double", 1);
+  trie_insert(trie, "do", 2); /* the earlier pattern keeps "do" */
+  trie_insert(trie, "if", 3);
+
+  Span span = trie_match_span(trie, "x doubles", 9);
+  assert(span.start == 2 && span.len == 6 && span.pattern == 1);
+  span = trie_match_span(trie, "x doub", 6);
+  assert(span.start == 2 && span.len == 2 && span.pattern == 0);
+  span = trie_match_span(trie, "xyz", 3);
+  assert(span.start == 3 && span.len == 0 && span.pattern == -1);
+  assert(trie->prefilter.count == 2);
+
+  bool hit_end;
+  trie_find(trie, "x doub", 6, 6, &hit_end);
+  assert(hit_end);
+  trie_find(trie, "x dox", 5, 5, &hit_end);
+  assert(!hit_end);
+  free_trie(trie);
+}
+
+/* tokens of the patterns with the plain NFA, as a string to compare */
+void reference_tokens(char **patterns, size_t len, char *input, char *out) {
+  NFA *nfa = build_many(patterns, len);
+  IdxType input_len = strlen(input);
+  IdxType position = 0;
+  out[0] = '\0';
+  while (position < input_len) {
+    Span span = match_span(nfa, input + position, input_len - position);
+    if (span.pattern < 0)
+      break;
+    sprintf(out + strlen(out), "%lu:%lu:%d ", span.start + position, span.len,
+            span.pattern);
+    position += span.start + span.len;
+  }
+  free_nfa(nfa);
+}
+
+void scanner_tokens(Automaton *automaton, char *input, char *out) {
+  Scanner *scanner = new_scanner(automaton);
+  scanner_set_buffer(scanner, input, strlen(input));
+  out[0] = '\0';
+  while (!scanner_is_done(scanner)) {
+    Span span = scanner_match_span(scanner);
+    if (span.pattern < 0)
+      break;
+    sprintf(out + strlen(out), "%lu:%lu:%d ", span.start, span.len,
+            span.pattern);
+  }
+  free_scanner(scanner);
+}
+
+/* literal and other patterns mixed give the same tokens as the NFA alone */
+void mixed_patterns() {
+  char *pattern_sets[][8] = {
+      {"if|else", "[a-z]+", "[0-9]+", "==|=", "[ ]+", NULL},
+      {"[a-z]+", "if|else", "[0-9]+", "==|=", "[ ]+", NULL},
+      {"do", "double", "d[a-z]*", "[ ]+", "do", NULL},
+      {"abc", "abcd", "b", "cd", "d+", NULL},
+      {"x", "y", "z", NULL},
+  };
+  char *inputs[] = {
+      "if x == 10 else doubles", "iffy = elsewhere", "do double dog doubled",
+      "abcdd abc bcd abcd",      "xyz?zyx",          "",
+  };
+  char expected[1024], got[1024];
+  for (size_t p = 0; p < sizeof(pattern_sets) / sizeof(pattern_sets[0]);
+       ++p) {
+    size_t len = 0;
+    while (pattern_sets[p][len] != NULL)
+      ++len;
+    for (size_t e = 0; e < ENGINES_LEN; ++e) {
+      Automaton *automaton = compile(pattern_sets[p], len, engines[e]);
+      /* only the NFA engine leaves literals to a trie */
+      assert((automaton->trie != NULL) == (engines[e] == ENGINE_NFA));
+      for (size_t i = 0; i < sizeof(inputs) / sizeof(char *); ++i) {
+        reference_tokens(pattern_sets[p], len, inputs[i], expected);
+        scanner_tokens(automaton, inputs[i], got);
+        assert(strcmp(expected, got) == 0);
+      }
+      free_automaton(automaton);
+    }
+  }
+}
+
+/* literal patterns never reach the NFA */
+void keywords_out_of_nfa() {
+  char *patterns[] = {"auto", "break", "case", "char", "const", "[a-z]+"};
+  Automaton *automaton = compile(patterns, 6, ENGINE_NFA);
+  assert(automaton->nfa_patterns_len == 1);
+  assert(automaton->nfa_patterns[0] == 5);
+  free_automaton(automaton);
+}
+
+int main(int argc, char *argv[]) {
+  detect_literals();
+  trie();
+  mixed_patterns();
+  keywords_out_of_nfa();
+
+  printf("All tests in literal.c pass!\n");
+  return EXIT_SUCCESS;
+}
@@ -4,9 +4,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 void match_one_pattern() {
-  g_state_counts = 0;
   NFA *nfa = build("fo(o|ba*r)*baz");
 
   assert(match_full(nfa, "fobaz"));
@@ -67,8 +68,58 @@ void yy() {
   free_nfa(nfa);
 }
 
+void spans() {
+  char *patterns[] = {"[a-z]+", "[0-9]+", "ab"};
+  IdxType len = sizeof(patterns) / sizeof(char *);
+  NFA *nfa = build_many(patterns, len);
+
+  /* offsets into the input, nothing is copied */
+  char *input = "  42 xyz";
+  Span span = match_span(nfa, input, strlen(input));
+  assert(span.start == 2 && span.len == 2 && span.pattern == 1);
+  span = match_span(nfa, input + 4, strlen(input + 4));
+  assert(span.start == 1 && span.len == 3 && span.pattern == 0);
+  span = match_span(nfa, "  ", 2);
+  assert(span.pattern == -1 && span.len == 0);
+
+  /* a failed attempt does not hide a match starting inside it */
+  NFA *ab = build("ab");
+  char text[10];
+  assert(match(ab, "aab", text) == 2);
+  assert(strcmp(text, "ab") == 0);
+  free_nfa(ab);
+
+  /* the scanner stops right after the longest match */
+  g_buffer = "abc 12 ab";
+  g_buflen = strlen(g_buffer);
+  g_buffer_ptr = g_buffer;
+  span = yy_match_span(nfa);
+  assert(span.start == 0 && span.len == 3 && span.pattern == 0);
+  assert(yy_match(nfa) == 1);
+  assert(yyleng == 2 && strcmp(yytext, "12") == 0);
+  span = yy_match_span(nfa);
+  assert(span.start == 7 && span.len == 2 && span.pattern == 0);
+  assert(yy_match(nfa) == -1);
+  assert(g_buffer_ptr == g_buffer + g_buflen);
+
+  /* tokens are not limited in length */
+  IdxType long_len = 5000;
+  char *long_input = malloc(long_len + 2);
+  memset(long_input, 'x', long_len);
+  long_input[long_len] = '1';
+  long_input[long_len + 1] = '\0';
+  g_buffer = long_input;
+  g_buflen = long_len + 1;
+  g_buffer_ptr = g_buffer;
+  assert(yy_match(nfa) == 0);
+  assert(yyleng == long_len && strlen(yytext) == long_len);
+  assert(yy_match(nfa) == 1);
+  free(long_input);
+
+  free_nfa(nfa);
+}
+
 bool build_and_match(char *pattern, char *input) {
-  g_state_counts = 0;
   NFA *nfa = build(pattern);
   bool result = match_full(nfa, input);
   free_nfa(nfa);
@@ -104,12 +155,209 @@ void extended_rules() {
   assert(build_and_match("\\n", "\n"));
 }
 
+void prefilter() {
+  NFA *nfa = build("fo(o|ba*r)*baz");
+  Span span = match_span(nfa, "xxxxfxfobrbazfo", 15);
+  assert(span.start == 6 && span.len == 7 && span.pattern == 0);
+  assert(nfa->prefilter.count == 1 && nfa->prefilter.single == 'f');
+  free_nfa(nfa);
+
+  char *patterns[] = {"[a-c]x", "y*z", "\\n"};
+  nfa = build_many(patterns, sizeof(patterns) / sizeof(char *));
+  char text[8];
+  assert(match(nfa, "--- yyz", text) == 3);
+  assert(strcmp(text, "yyz") == 0);
+  assert(match(nfa, "bbbbbx", text) == 2);
+  assert(nfa->prefilter.count == 6);
+  assert(have_char(&nfa->prefilter.set, '\n'));
+  assert(!have_char(&nfa->prefilter.set, 'x'));
+  free_nfa(nfa);
+
+  /* a pattern starting with any char skips nothing */
+  nfa = build(".b");
+  assert(match(nfa, "aab", text) == 2);
+  assert(nfa->prefilter.count == 255);
+  free_nfa(nfa);
+}
+
+/* more states and edges than a small fixed table could hold */
+void many_patterns() {
+  size_t len = 10000;
+  char **patterns = (char **)malloc(len * sizeof(char *));
+  for (size_t i = 0; i < len; ++i) {
+    patterns[i] = (char *)malloc(16);
+    sprintf(patterns[i], "kw%zux", i);
+  }
+  NFA *nfa = build_many(patterns, len);
+  /* more than 16-bit state ids can count */
+  assert(nfa->states_count > 65536);
+
+  Span span = match_span(nfa, "a kw9999x", 9);
+  assert(span.start == 2 && span.len == 7 && span.pattern == 9999);
+  span = match_span(nfa, "kw10000x", 8);
+  assert(span.pattern == -1);
+
+  free_nfa(nfa);
+  for (size_t i = 0; i < len; ++i)
+    free(patterns[i]);
+  free(patterns);
+}
+
+/* call `check` with every input of chars of `alphabet` up to `max_len` long */
+void for_each_input(char *alphabet, IdxType max_len,
+                    void (*check)(char *input, IdxType len, void *data),
+                    void *data) {
+  IdxType chars = strlen(alphabet);
+  char *input = (char *)malloc(max_len + 1);
+  for (IdxType len = 0; len <= max_len; ++len) {
+    IdxType total = 1;
+    for (IdxType i = 0; i < len; ++i)
+      total *= chars;
+    for (IdxType n = 0; n < total; ++n) {
+      IdxType k = n;
+      for (IdxType i = 0; i < len; ++i, k /= chars)
+        input[i] = alphabet[k % chars];
+      input[len] = '\0';
+      check(input, len, data);
+    }
+  }
+  free(input);
+}
+
+/* an NFA and its DFA, which must match the same as `expected` */
+typedef struct SameMatches {
+  NFA *nfa;
+  DFA *dfa;
+  NFA *expected;
+} SameMatches;
+
+/*
+ * the bit-parallel matcher, the NFA without it, and the DFA agree with
+ * `expected` on an input
+ */
+void check_same_matches(char *input, IdxType len, void *data) {
+  SameMatches *same = (SameMatches *)data;
+  Span expected = match_span(same->expected, input, len);
+  Span got[3];
+  got[0] = match_span(same->nfa, input, len);
+  BitNFA *bits = same->nfa->bits;
+  same->nfa->bits = NULL;
+  got[1] = match_span(same->nfa, input, len);
+  same->nfa->bits = bits;
+  got[2] = dfa_match_span(same->dfa, input, len);
+  for (int e = 0; e < 3; ++e)
+    assert(got[e].start == expected.start && got[e].len == expected.len &&
+           got[e].pattern == expected.pattern);
+  assert(match_full(same->nfa, input) == match_full(same->expected, input));
+}
+
+/* if a pattern builds, in a child process as a bad pattern exits */
+bool builds(char *pattern) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    free_nfa(build(pattern));
+    exit(EXIT_SUCCESS);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+/* ?, {n}, {n,} and {m,n} match the same as the patterns written out */
+void bounded_repetition() {
+  char *pairs[][2] = {
+      {"a?b", "b|ab"},
+      {"(ab){2}", "abab"},
+      {"a{2,}", "aaa*"},
+      {"[0-9]{1,3}", "[0-9]|[0-9][0-9]|[0-9][0-9][0-9]"},
+      {"x{0}y", "y"},
+      {"(a|b){0,2}c", "c|(a|b)c|(a|b)(a|b)c"},
+      {"(a?){2,}b", "a*b"},
+      {"(ab+){1,2}", "ab(b)*|ab(b)*ab(b)*"},
+      {"a+?", "a*"},
+  };
+  for (size_t p = 0; p < sizeof(pairs) / sizeof(pairs[0]); ++p)
+    for (int c = 0; c < 2; ++c) {
+      Construction construction = c == 0 ? THOMPSON : GLUSHKOV;
+      NFA *counted = build_with(pairs[p][0], construction);
+      NFA *written = build_with(pairs[p][1], construction);
+      SameMatches same = {counted, nfa2dfa(counted), written};
+      for_each_input("ab0cy", 5, check_same_matches, &same);
+      free_dfa(same.dfa);
+      free_nfa(counted);
+      free_nfa(written);
+    }
+
+  /* the repeated AST is not copied, each copy is only in the NFA */
+  NFA *nfa = build_with("[0-9]{8}", THOMPSON);
+  assert(nfa->states_count == 9);
+  free_nfa(nfa);
+
+  /* nested counts multiply, up to a limit */
+  Arena *arena = new_arena();
+  Ast *ast = parse_pattern(arena, "((ab){10}c){5,}");
+  assert(count_positions(ast, MAX_POSITIONS) == 105);
+  free_arena(arena);
+  assert(builds("((a{100}){10}){100}"));
+  assert(!builds("((a{1000}){1000}){1000}"));
+  assert(!builds("(a{1000}b{1000}){60}"));
+
+  /* braces which don't make a count are literals */
+  nfa = build("a{2|{x}|{,3}");
+  assert(match_full(nfa, "a{2"));
+  assert(match_full(nfa, "{x}"));
+  assert(match_full(nfa, "{,3}"));
+  assert(!match_full(nfa, "aa"));
+  free_nfa(nfa);
+
+  /* in brackets, `?` and counts are plain chars */
+  nfa = build("[?]");
+  assert(match_full(nfa, "?"));
+  free_nfa(nfa);
+  nfa = build("[a?]");
+  assert(match_full(nfa, "a") && match_full(nfa, "?"));
+  assert(!match_full(nfa, "a?"));
+  free_nfa(nfa);
+  nfa = build("[{1}]");
+  assert(match_full(nfa, "{") && match_full(nfa, "1") && match_full(nfa, "}"));
+  assert(!match_full(nfa, "{1}"));
+  free_nfa(nfa);
+}
+
+/* simplified patterns match the same as the NFA of the parsed AST */
+void simplified_patterns() {
+  char *patterns[] = {
+      "a|a",         "ab|ac|a",         "(a|b|c)(a|bc)*",  "((a*)*b)+|ab",
+      "(x?)+d|(x+)?", "if|ifdef|ifndef", "(ab|ad)*|a[b-d]", "(a|ab)(c|bcd)",
+  };
+  for (size_t p = 0; p < sizeof(patterns) / sizeof(char *); ++p) {
+    NFA *raw = new_nfa();
+    Ast *ast = parse_pattern(raw->arena, patterns[p]);
+    thompson_nfa(raw, &ast, 1);
+    finalize_nfa(raw);
+    for (int c = 0; c < 2; ++c) {
+      NFA *nfa = build_with(patterns[p], c == 0 ? THOMPSON : GLUSHKOV);
+      SameMatches same = {nfa, nfa2dfa(nfa), raw};
+      for_each_input("abcdx", 5, check_same_matches, &same);
+      free_dfa(same.dfa);
+      free_nfa(nfa);
+    }
+    free_nfa(raw);
+  }
+}
+
 int main(int argc, char *argv[]) {
   match_one_pattern();
   match_multiple_patterns();
   match_partitially();
   yy();
+  spans();
   extended_rules();
+  prefilter();
+  many_patterns();
+  bounded_repetition();
+  simplified_patterns();
 
   printf("All tests in match.c pass!\n");
   return EXIT_SUCCESS;
@@ -7,20 +7,21 @@
 NFA *init_nfa() {
   char EPS = EPSILON;
   NFA *nfa = new_nfa();
+  Arena *a = nfa->arena;
   set_states_count(nfa, 8);
   States *target_states = new_states();
   push_state(target_states, 7);
   nfa->target_states = target_states;
-  push_edge(nfa, new_edge(new_literal_label(EPS), 1, 2));
-  push_edge(nfa, new_edge(new_literal_label(EPS), 1, 4));
-  push_edge(nfa, new_edge(new_literal_label(EPS), 3, 6));
-  push_edge(nfa, new_edge(new_literal_label(EPS), 5, 6));
-  push_edge(nfa, new_edge(new_literal_label('a'), 2, 3));
-  push_edge(nfa, new_edge(new_literal_label('b'), 4, 5));
-  push_edge(nfa, new_edge(new_literal_label(EPS), 0, 1));
-  push_edge(nfa, new_edge(new_literal_label(EPS), 0, 7));
-  push_edge(nfa, new_edge(new_literal_label(EPS), 6, 1));
-  push_edge(nfa, new_edge(new_literal_label(EPS), 6, 7));
+  push_edge(nfa, new_edge(a, new_literal_label(a, EPS), 1, 2));
+  push_edge(nfa, new_edge(a, new_literal_label(a, EPS), 1, 4));
+  push_edge(nfa, new_edge(a, new_literal_label(a, EPS), 3, 6));
+  push_edge(nfa, new_edge(a, new_literal_label(a, EPS), 5, 6));
+  push_edge(nfa, new_edge(a, new_literal_label(a, 'a'), 2, 3));
+  push_edge(nfa, new_edge(a, new_literal_label(a, 'b'), 4, 5));
+  push_edge(nfa, new_edge(a, new_literal_label(a, EPS), 0, 1));
+  push_edge(nfa, new_edge(a, new_literal_label(a, EPS), 0, 7));
+  push_edge(nfa, new_edge(a, new_literal_label(a, EPS), 6, 1));
+  push_edge(nfa, new_edge(a, new_literal_label(a, EPS), 6, 7));
 
   assert(nfa->states_count == 8);
   assert(nfa->edges_count == 10);
@@ -46,17 +47,117 @@ void basic_operations(NFA *nfa) {
 
   s = epsilon_closure(nfa, s);
   assert(s->len == 6); /* 1, 2, 3, 4, 6, 7 */
+  free_states(s);
+}
+
+/* test the rows of outgoing edges */
+void adjacency(NFA *nfa) {
+  finalize_nfa(nfa);
+  assert(nfa->finalized);
+
+  /* 0 --ε--> 1, 0 --ε--> 7 */
+  assert(nfa->epsilon_offsets[1] - nfa->epsilon_offsets[0] == 2);
+  assert(nfa->epsilon_to[nfa->epsilon_offsets[0]] == 1);
+  assert(nfa->epsilon_to[nfa->epsilon_offsets[0] + 1] == 7);
+  assert(nfa->symbol_offsets[1] == nfa->symbol_offsets[0]);
+
+  /* 2 --a--> 3 */
+  assert(nfa->epsilon_offsets[3] == nfa->epsilon_offsets[2]);
+  assert(nfa->symbol_offsets[3] - nfa->symbol_offsets[2] == 1);
+  assert(nfa->symbol_to[nfa->symbol_offsets[2]] == 3);
+  assert(nfa->symbol_labels[nfa->symbol_offsets[2]]->data.symbol == 'a');
+
+  /* 7 has no outgoing edge */
+  assert(nfa->epsilon_offsets[8] == nfa->epsilon_offsets[7]);
+  assert(nfa->symbol_offsets[8] == nfa->symbol_offsets[7]);
+
+  /* pushing an edge lays them out again on the next step */
+  NFA *copy = new_nfa();
+  for (size_t i = 0; i < nfa->edges_count; ++i)
+    push_edge(copy, nfa->edges[i]);
+  States *s = new_states();
+  push_state(s, 7);
+  close_states(copy, s);
+  assert(s->len == 1);
+  push_edge(copy, new_edge(copy->arena,
+                           new_literal_label(copy->arena, EPSILON), 7, 0));
+  assert(!copy->finalized);
+  close_states(copy, s);
+  assert(s->len == 5); /* 7, 0, 1, 2, 4 */
+  assert(copy->states_count == 8);
+  free_states(s);
+  free_nfa(copy); /* the edges of `nfa` are in its own arena */
+}
+
+/* test the sparse set of states */
+void states_container() {
+  States *s = new_states_with_capacity(4);
+  push_state(s, 3);
+  push_state(s, 1);
+  push_state(s, 3);
+  assert(s->len == 2);
+  assert(have_state(s, 1) && have_state(s, 3));
+  assert(!have_state(s, 0) && !have_state(s, 100));
+
+  /* grows past its capacity */
+  push_state(s, 100);
+  assert(have_state(s, 100) && have_state(s, 3));
+
+  sort_states(s);
+  assert(s->states[0] == 1 && s->states[1] == 3 && s->states[2] == 100);
+  assert(have_state(s, 1) && have_state(s, 3) && have_state(s, 100));
+
+  clear_states(s);
+  assert(states_is_empty(s));
+  assert(!have_state(s, 1));
+  free_states(s);
+
+  /* a few large states are kept in a list, more make a sparse set */
+  s = new_states();
+  for (State state = 100000; state > 100000 - STATES_LIST_MAX; --state)
+    push_state(s, state);
+  assert(s->sparse == NULL && have_state(s, 100000));
+  push_state(s, 7);
+  assert(s->sparse != NULL && s->capacity > 100000);
+  assert(s->len == STATES_LIST_MAX + 1);
+  assert(have_state(s, 100000) && have_state(s, 7) && !have_state(s, 8));
+  sort_states(s);
+  assert(s->states[0] == 7 && have_state(s, 100000));
+  free_states(s);
+}
+
+/* test stepping without allocation */
+void step(NFA *nfa) {
+  States *s = new_states_with_capacity(nfa->states_count);
+  States *next = new_states_with_capacity(nfa->states_count);
+  push_state(s, 0);
+  close_states(nfa, s);
+  assert(s->len == 5); /* 0, 1, 2, 4, 7 */
+
+  States *current = s;
+  step_states(nfa, &s, &next, 'b');
+  assert(next == current); /* swapped */
+  assert(s->len == 6);     /* 1, 2, 4, 5, 6, 7 */
+  assert(have_state(s, 5) && !have_state(s, 3));
+
+  step_states(nfa, &s, &next, 'c');
+  assert(states_is_empty(s));
+  free_states(s);
+  free_states(next);
 }
 
 int main(int argc, char *argv[]) {
   NFA *nfa = init_nfa();
 
   basic_operations(nfa);
+  adjacency(nfa);
+  states_container();
+  step(nfa);
 
   assert(match_full(nfa, "aabb"));
   assert(!match_full(nfa, "abc"));
 
-  free(nfa);
+  free_nfa(nfa);
 
   printf("All tests in nfa.c pass!\n");
   return EXIT_SUCCESS;
@@ -0,0 +1,98 @@
+#include "../src/parallel.c"
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+char *patterns[] = {"if|else|while", "[a-zA-Z_][a-zA-Z0-9_]*", "[0-9]+",
+                    "[ \\t\\n]+", "==|=|<|>|\\+|\\-|\\*|/", "\\(|\\)|{|}|;",
+                    "\"[^\"]*\""};
+#define PATTERNS_LEN (sizeof(patterns) / sizeof(char *))
+
+Engine engines[] = {ENGINE_NFA, ENGINE_DFA, ENGINE_LAZY_DFA};
+#define ENGINES_LEN (sizeof(engines) / sizeof(Engine))
+
+typedef struct Tokens {
+  Span *spans;
+  size_t len;
+  size_t capacity;
+} Tokens;
+
+void collect(char *buffer, Span span, void *data) {
+  (void)buffer; /* tokens are compared by span */
+  Tokens *tokens = (Tokens *)data;
+  if (tokens->len == tokens->capacity) {
+    tokens->capacity = tokens->capacity * 2 + 16;
+    tokens->spans =
+        (Span *)realloc(tokens->spans, tokens->capacity * sizeof(Span));
+  }
+  tokens->spans[tokens->len++] = span;
+}
+
+/* tokens of a sequential scan, without the unmatched tail */
+Tokens scan_sequential(Automaton *automaton, char *input, IdxType len) {
+  Tokens tokens = {NULL, 0, 0};
+  Scanner *scanner = new_scanner(automaton);
+  scanner_set_buffer(scanner, input, len);
+  while (!scanner_is_done(scanner)) {
+    Span span = scanner_match_span(scanner);
+    if (span.pattern < 0)
+      break;
+    collect(input, span, &tokens);
+  }
+  free_scanner(scanner);
+  return tokens;
+}
+
+void same_as_sequential(char *input) {
+  IdxType len = strlen(input);
+  size_t threads[] = {0, 1, 2, 3, 4, 7, 16, 1000};
+  for (size_t e = 0; e < ENGINES_LEN; ++e) {
+    Automaton *automaton = compile(patterns, PATTERNS_LEN, engines[e]);
+    Tokens expected = scan_sequential(automaton, input, len);
+    for (size_t t = 0; t < sizeof(threads) / sizeof(size_t); ++t) {
+      Tokens tokens = {NULL, 0, 0};
+      scan_parallel(automaton, input, len, threads[t], collect, &tokens);
+      assert(tokens.len == expected.len);
+      for (size_t i = 0; i < tokens.len; ++i) {
+        assert(tokens.spans[i].start == expected.spans[i].start);
+        assert(tokens.spans[i].len == expected.spans[i].len);
+        assert(tokens.spans[i].pattern == expected.spans[i].pattern);
+      }
+      free(tokens.spans);
+    }
+    free(expected.spans);
+    free_automaton(automaton);
+  }
+}
+
+/* chunks cut through tokens, and strings make speculative starts wrong */
+void chunk_edges() {
+  same_as_sequential("while (x1 == 42) { y = y + 1; }");
+  same_as_sequential("\"a b\" \"c d\" \"e f\" \"g h\" \"i j\" \"k l\" x");
+  same_as_sequential("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+  same_as_sequential("x @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@");
+  same_as_sequential("@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@");
+  same_as_sequential("");
+}
+
+void large_buffer() {
+  char *line = "if (a < b) { s = \"x; y\" + 12; } else { x = y * 3; }\n";
+  IdxType line_len = strlen(line);
+  size_t lines = 2000;
+  char *input = malloc(line_len * lines + 1);
+  for (size_t i = 0; i < lines; ++i)
+    memcpy(input + i * line_len, line, line_len);
+  input[line_len * lines] = '\0';
+  same_as_sequential(input);
+  free(input);
+}
+
+int main(int argc, char *argv[]) {
+  chunk_edges();
+  large_buffer();
+
+  printf("All tests in parallel.c pass!\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+#include "../src/scanner.c"
+#include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+char *patterns[] = {"if|else|while", "[a-zA-Z_][a-zA-Z0-9_]*", "[0-9]+",
+                    "[ \\t\\n]+", "==|=|<|>|\\+|\\-|\\*|/", "\\(|\\)|{|}|;", "."};
+#define PATTERNS_LEN (sizeof(patterns) / sizeof(char *))
+
+Engine engines[] = {ENGINE_NFA, ENGINE_DFA, ENGINE_LAZY_DFA};
+#define ENGINES_LEN (sizeof(engines) / sizeof(Engine))
+
+void scan_tokens() {
+  for (size_t e = 0; e < ENGINES_LEN; ++e) {
+    Automaton *automaton = compile(patterns, PATTERNS_LEN, engines[e]);
+    Scanner *scanner = new_scanner(automaton);
+    char *input = "while (x1 == 42) { y = y + 1; }";
+    scanner_set_buffer(scanner, input, strlen(input));
+
+    int expected[] = {0, 3, 5, 1, 3, 4, 3, 2, 5, 3, 5, 3, 1, 3,
+                      4, 3, 1, 3, 4, 3, 2, 5, 3, 5};
+    size_t i = 0;
+    while (!scanner_is_done(scanner)) {
+      assert(scanner_match(scanner) == expected[i]);
+      ++i;
+    }
+    assert(i == sizeof(expected) / sizeof(int));
+    assert(strcmp(scanner->yytext, "}") == 0);
+    assert(scanner_match(scanner) == -1);
+
+    free_scanner(scanner);
+    free_automaton(automaton);
+  }
+}
+
+/* two scanners on one automaton don't see each other */
+void independent_scanners() {
+  Automaton *automaton = compile(patterns, PATTERNS_LEN, ENGINE_DFA);
+  Scanner *a = new_scanner(automaton);
+  Scanner *b = new_scanner(automaton);
+  scanner_set_buffer(a, "abc 123", 7);
+  scanner_set_buffer(b, "456 def", 7);
+
+  assert(scanner_match(a) == 1);
+  assert(scanner_match(b) == 2);
+  assert(strcmp(a->yytext, "abc") == 0);
+  assert(strcmp(b->yytext, "456") == 0);
+  Span span = scanner_match_span(a);
+  assert(span.start == 3 && span.len == 1 && span.pattern == 3);
+
+  free_scanner(a);
+  free_scanner(b);
+  free_automaton(automaton);
+}
+
+typedef struct Job {
+  Automaton *automaton;
+  char *input;
+  IdxType len;
+  unsigned long checksum;
+} Job;
+
+/* sum of token positions and patterns, to compare scans */
+void *scan_job(void *arg) {
+  Job *job = (Job *)arg;
+  Scanner *scanner = new_scanner(job->automaton);
+  scanner_set_buffer(scanner, job->input, job->len);
+  job->checksum = 0;
+  while (!scanner_is_done(scanner)) {
+    Span span = scanner_match_span(scanner);
+    job->checksum = job->checksum * 31 + span.start * 7 + span.pattern;
+  }
+  free_scanner(scanner);
+  return NULL;
+}
+
+/* threads scanning different buffers with one shared automaton */
+void threads() {
+  char *line = "if (a < b) { count = count + 12; } else { x = y * 3; }\n";
+  IdxType line_len = strlen(line);
+  size_t lines = 200;
+
+  for (size_t e = 0; e < ENGINES_LEN; ++e) {
+    Automaton *automaton = compile(patterns, PATTERNS_LEN, engines[e]);
+    Job jobs[4];
+    pthread_t threads[4];
+    for (size_t t = 0; t < 4; ++t) {
+      /* each thread gets a different number of lines */
+      jobs[t].automaton = automaton;
+      jobs[t].len = line_len * (lines + t);
+      jobs[t].input = malloc(jobs[t].len + 1);
+      for (size_t i = 0; i < lines + t; ++i)
+        memcpy(jobs[t].input + i * line_len, line, line_len);
+      jobs[t].input[jobs[t].len] = '\0';
+    }
+    for (size_t t = 0; t < 4; ++t)
+      pthread_create(&threads[t], NULL, scan_job, &jobs[t]);
+    for (size_t t = 0; t < 4; ++t)
+      pthread_join(threads[t], NULL);
+
+    for (size_t t = 0; t < 4; ++t) {
+      unsigned long checksum = jobs[t].checksum;
+      scan_job(&jobs[t]);
+      assert(jobs[t].checksum == checksum);
+      free(jobs[t].input);
+    }
+    free_automaton(automaton);
+  }
+}
+
+typedef struct Source {
+  char *input;
+  IdxType len;
+  IdxType read;
+  IdxType chunk; /* at most this many bytes per refill */
+} Source;
+
+IdxType refill_source(char *buffer, IdxType max, void *data) {
+  Source *source = (Source *)data;
+  IdxType n = source->len - source->read;
+  if (n > max)
+    n = max;
+  if (n > source->chunk)
+    n = source->chunk;
+  memcpy(buffer, source->input + source->read, n);
+  source->read += n;
+  return n;
+}
+
+/* a stream read in small pieces gives the same tokens as the whole buffer */
+void streaming() {
+  char *inputs[] = {
+      "while (x1 == 42) { y = y + 1; }",
+      "if (a < b) { count = count + 12; } else { x = y * 3; }\n",
+      "a_very_long_identifier_longer_than_the_buffer = 1234567890123;",
+      "  @@ x  ",
+      "",
+  };
+  IdxType capacities[] = {1, 2, 3, 8, 64};
+  IdxType chunks[] = {1, 2, 5, 100};
+
+  for (size_t e = 0; e < ENGINES_LEN; ++e) {
+    Automaton *automaton = compile(patterns, PATTERNS_LEN, engines[e]);
+    Scanner *whole = new_scanner(automaton);
+    Scanner *stream = new_scanner(automaton);
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(char *); ++i)
+      for (size_t c = 0; c < sizeof(capacities) / sizeof(IdxType); ++c)
+        for (size_t k = 0; k < sizeof(chunks) / sizeof(IdxType); ++k) {
+          IdxType len = strlen(inputs[i]);
+          Source source = {inputs[i], len, 0, chunks[k]};
+          scanner_set_buffer(whole, inputs[i], len);
+          scanner_set_input(stream, refill_source, &source, capacities[c]);
+          while (!scanner_is_done(whole)) {
+            assert(!scanner_is_done(stream));
+            int expected = scanner_match(whole);
+            assert(scanner_match(stream) == expected);
+            assert(strcmp(stream->yytext, whole->yytext) == 0);
+          }
+          assert(scanner_is_done(stream));
+          assert(source.read == len);
+        }
+    free_scanner(whole);
+    free_scanner(stream);
+    free_automaton(automaton);
+  }
+
+  /* spans count from the start of the stream */
+  Automaton *automaton = compile(patterns, PATTERNS_LEN, ENGINE_DFA);
+  Scanner *scanner = new_scanner(automaton);
+  Source source = {"abc 123 def", 11, 0, 2};
+  scanner_set_input(scanner, refill_source, &source, 4);
+  scanner_match_span(scanner);
+  scanner_match_span(scanner);
+  Span span = scanner_match_span(scanner);
+  assert(span.start == 4 && span.len == 3 && span.pattern == 2);
+  assert(scanner->buffer_capacity == 4);
+  free_scanner(scanner);
+  free_automaton(automaton);
+}
+
+int main(int argc, char *argv[]) {
+  scan_tokens();
+  independent_scanners();
+  threads();
+  streaming();
+
+  printf("All tests in scanner.c pass!\n");
+  return EXIT_SUCCESS;
+}
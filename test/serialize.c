@@ -0,0 +1,99 @@
+#include "../src/match.c"
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+char *patterns[] = {"if|else", "[a-z_][a-z0-9_]*", "[0-9]+", "[ \\n]+",
+                    "fo(o|ba*r)*baz"};
+#define PATTERNS_LEN (sizeof(patterns) / sizeof(char *))
+
+char path[] = "/tmp/re_test_dfa_XXXXXX";
+
+DFA *compile_dfa() {
+  NFA *nfa = build_many(patterns, PATTERNS_LEN);
+  DFA *dfa = nfa2dfa(nfa);
+  dfa_minimize(dfa);
+  free_nfa(nfa);
+  return dfa;
+}
+
+void save_and_load() {
+  DFA *dfa = compile_dfa();
+  assert(save_dfa(dfa, path) == 0);
+  DFA *loaded = load_dfa(path);
+  assert(loaded != NULL);
+  assert(loaded->states_count == dfa->states_count);
+  assert(loaded->start == dfa->start);
+  assert(loaded->classes_count == dfa->classes_count);
+  assert(loaded->prefilter.count == dfa->prefilter.count);
+
+  char *inputs[] = {"if", "iffy", "x1_ 42", "  fobrbaaarbaz", "@@@", ""};
+  char text[32], loaded_text[32];
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(char *); ++i) {
+    assert(dfa_match_full(dfa, inputs[i]) ==
+           dfa_match_full(loaded, inputs[i]));
+    assert(dfa_match(dfa, inputs[i], text) ==
+           dfa_match(loaded, inputs[i], loaded_text));
+    assert(strcmp(text, loaded_text) == 0);
+  }
+
+  g_buffer = "else if x = 12";
+  g_buflen = strlen(g_buffer);
+  g_buffer_ptr = g_buffer;
+  assert(dfa_yy_match(loaded) == 0);
+  assert(strcmp(yytext, "else") == 0);
+
+  /* already minimized, and read-only */
+  MinimizeReport report = dfa_minimize(loaded);
+  assert(report.states_before == report.states_after);
+
+  free_dfa(loaded);
+  free_dfa(dfa);
+}
+
+/* flip one byte at an offset of the file */
+void corrupt(long offset) {
+  FILE *file = fopen(path, "r+b");
+  fseek(file, offset, SEEK_SET);
+  int c = fgetc(file);
+  fseek(file, offset, SEEK_SET);
+  fputc(c ^ 0x5a, file);
+  fclose(file);
+}
+
+void invalid_files() {
+  DFA *dfa = compile_dfa();
+
+  /* wrong magic, version, and payload */
+  long offsets[] = {0, 8, sizeof(DFAFileHeader) + 300};
+  for (size_t i = 0; i < sizeof(offsets) / sizeof(long); ++i) {
+    assert(save_dfa(dfa, path) == 0);
+    corrupt(offsets[i]);
+    errno = 0;
+    assert(load_dfa(path) == NULL);
+    assert(errno == EINVAL);
+  }
+
+  /* truncated */
+  assert(save_dfa(dfa, path) == 0);
+  assert(truncate(path, 20) == 0);
+  assert(load_dfa(path) == NULL);
+
+  assert(load_dfa("/nonexistent/re_test") == NULL);
+  assert(errno == ENOENT);
+  assert(save_dfa(dfa, "/nonexistent/re_test") == -1);
+  free_dfa(dfa);
+}
+
+int main(int argc, char *argv[]) {
+  close(mkstemp(path));
+  save_and_load();
+  invalid_files();
+  unlink(path);
+
+  printf("All tests in serialize.c pass!\n");
+  return EXIT_SUCCESS;
+}